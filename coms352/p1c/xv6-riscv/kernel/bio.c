@@ -1,6 +1,6 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
@@ -22,34 +22,150 @@
 #include "defs.h"
 #include "fs.h"
 #include "buf.h"
+#include "slab.h"
+#include "memstat.h"
 
+#define NBUCKET 257  // hash buckets; prime, so block numbers spread
+
+// A buffer is in the bucket for (dev, blockno). A cached block is
+// found, and the reference counts of its buffer changed, holding
+// just that bucket's lock. Instead of an LRU list, each buffer
+// records when it was last released.
+//
+// The cache starts with NBUF buffers and grows by one on each
+// miss, up to NBUFMAX. After that, or when out of memory, a miss
+// recycles the unused buffer released longest ago, from whichever
+// bucket. bshrink() frees unused buffers, down to NBUF, when user
+// memory runs short.
 struct {
-  struct spinlock lock;
-  struct buf buf[NBUF];
+  struct spinlock lock;    // one recycler at a time; protects nbuf, nwait
+  struct slabcache cache;
+  int nbuf;                // buffers allocated
+  int nwait;               // bget()s waiting for a buffer to be released
+  uint64 nhit, nmiss;      // bread()s found valid, and read from disk
+  uint64 nahead;           // blocks read ahead
 
-  // Linked list of all buffers, through prev/next.
-  // Sorted by how recently the buffer was used.
-  // head.next is most recent, head.prev is least.
-  struct buf head;
+  struct {
+    struct spinlock lock;
+    struct buf *head;      // list through next/prev
+  } bucket[NBUCKET];
 } bcache;
 
+static void bput(struct buf*);
+
+static uint
+bhash(uint dev, uint blockno)
+{
+  return (dev * 31 + blockno) % NBUCKET;
+}
+
+// Put b at the front of bucket h. Caller holds its lock.
+static void
+binsert(int h, struct buf *b)
+{
+  b->prev = 0;
+  b->next = bcache.bucket[h].head;
+  if(b->next)
+    b->next->prev = b;
+  bcache.bucket[h].head = b;
+}
+
+// Take b out of bucket h. Caller holds its lock.
+static void
+bremove(int h, struct buf *b)
+{
+  if(b->prev)
+    b->prev->next = b->next;
+  else
+    bcache.bucket[h].head = b->next;
+  if(b->next)
+    b->next->prev = b->prev;
+}
+
+// Allocate a new buffer, or return 0 if out of memory.
+// Caller holds bcache.lock.
+static struct buf*
+bnew(void)
+{
+  struct buf *b;
+
+  if((b = slaballoc(&bcache.cache)) == 0)
+    return 0;
+  memset(b, 0, sizeof(*b));
+  initsleeplock(&b->lock, "buffer");
+  bcache.nbuf++;
+  return b;
+}
+
 void
 binit(void)
 {
   struct buf *b;
 
   initlock(&bcache.lock, "bcache");
+  slabinit(&bcache.cache, "buf", sizeof(struct buf));
+  for(int h = 0; h < NBUCKET; h++)
+    initlock(&bcache.bucket[h].lock, "bcache.bucket");
+
+  // The first buffers start out in bucket 0, holding no block.
+  for(int i = 0; i < NBUF; i++){
+    if((b = bnew()) == 0)
+      panic("binit");
+    binsert(0, b);
+  }
+}
 
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+// Is block blockno of dev cached in bucket h? If so, take a
+// reference and return its buffer. Caller holds the bucket lock.
+static struct buf*
+blookup(int h, uint dev, uint blockno)
+{
+  struct buf *b;
+
+  for(b = bcache.bucket[h].head; b; b = b->next){
+    if(b->dev == dev && b->blockno == blockno){
+      b->refcnt++;
+      return b;
+    }
   }
+  return 0;
+}
+
+// Find the unused buffer released longest ago and take it out of
+// its bucket. Returns it, or 0 if every buffer is in use.
+// Caller holds bcache.lock.
+static struct buf*
+bvictim(void)
+{
+  struct buf *b, *victim = 0;
+  int i, vh = -1, found;
+
+  // Keep the lock of the bucket holding the best one so far, so
+  // that it stays unused; other processes hold one bucket lock at
+  // most, so holding two cannot deadlock.
+  for(i = 0; i < NBUCKET; i++){
+    found = 0;
+    acquire(&bcache.bucket[i].lock);
+    for(b = bcache.bucket[i].head; b; b = b->next){
+      if(b->refcnt == 0 && (victim == 0 || b->lastuse < victim->lastuse)){
+        victim = b;
+        found = 1;
+      }
+    }
+    if(found){
+      if(vh >= 0)
+        release(&bcache.bucket[vh].lock);
+      vh = i;
+    } else {
+      release(&bcache.bucket[i].lock);
+    }
+  }
+  if(victim){
+    // out of every bucket, no one else can find it.
+    bremove(vh, victim);
+    release(&bcache.bucket[vh].lock);
+  }
+  return victim;
 }
 
 // Look through buffer cache for block on device dev.
@@ -59,33 +175,80 @@ static struct buf*
 bget(uint dev, uint blockno)
 {
   struct buf *b;
+  int h = bhash(dev, blockno);
 
-  acquire(&bcache.lock);
+  acquire(&bcache.bucket[h].lock);
+  b = blookup(h, dev, blockno);
+  release(&bcache.bucket[h].lock);
+  if(b){
+    acquiresleep(&b->lock);
+    return b;
+  }
 
-  // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
-    if(b->dev == dev && b->blockno == blockno){
-      b->refcnt++;
+  // Not cached. Only one process at a time adds blocks to the
+  // cache, so no one else can cache the block meanwhile; but
+  // another may have done it before we got here, or while we
+  // slept below.
+  acquire(&bcache.lock);
+  for(;;){
+    acquire(&bcache.bucket[h].lock);
+    b = blookup(h, dev, blockno);
+    release(&bcache.bucket[h].lock);
+    if(b){
       release(&bcache.lock);
       acquiresleep(&b->lock);
       return b;
     }
+
+    // grow the cache if within budget, else recycle a buffer;
+    // if all are in use, go over budget rather than wait.
+    if(bcache.nbuf < NBUFMAX && (b = bnew()) != 0)
+      break;
+    if((b = bvictim()) != 0 || (b = bnew()) != 0)
+      break;
+
+    // every buffer is in use and there is no memory for another,
+    // so wait for one to be released. Since we are counted in
+    // nwait before looking again, a release after that look
+    // wakes us.
+    bcache.nwait++;
+    if((b = bvictim()) == 0)
+      sleep(&bcache.nwait, &bcache.lock);
+    bcache.nwait--;
+    if(b)
+      break;
   }
 
-  // Not cached.
-  // Recycle the least recently used (LRU) unused buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
+  b->dev = dev;
+  b->blockno = blockno;
+  b->valid = 0;
+  b->refcnt = 1;
+  acquire(&bcache.bucket[h].lock);
+  binsert(h, b);
+  release(&bcache.bucket[h].lock);
+  release(&bcache.lock);
+  acquiresleep(&b->lock);
+  return b;
+}
+
+// Free up to n unused buffers, keeping at least NBUF, for memory
+// that is needed elsewhere. The slab cache gives a page back to
+// kalloc() once all the buffers in it are free.
+// Returns the number of buffers freed.
+int
+bshrink(int n)
+{
+  struct buf *b;
+  int freed = 0;
+
+  acquire(&bcache.lock);
+  while(freed < n && bcache.nbuf > NBUF && (b = bvictim()) != 0){
+    slabfree(&bcache.cache, b);
+    bcache.nbuf--;
+    freed++;
   }
-  panic("bget: no buffers");
+  release(&bcache.lock);
+  return freed;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -96,8 +259,11 @@ bread(uint dev, uint blockno)
 
   b = bget(dev, blockno);
   if(!b->valid) {
-    virtio_disk_rw(b, 0);
-    b->valid = 1;
+    bsubmit(b, 0);
+    bwait(b);
+    __atomic_add_fetch(&bcache.nmiss, 1, __ATOMIC_RELAXED);
+  } else {
+    __atomic_add_fetch(&bcache.nhit, 1, __ATOMIC_RELAXED);
   }
   return b;
 }
@@ -106,48 +272,177 @@ bread(uint dev, uint blockno)
 void
 bwrite(struct buf *b)
 {
-  if(!holdingsleep(&b->lock))
-    panic("bwrite");
-  virtio_disk_rw(b, 1);
+  bsubmit(b, 1);
+  bwait(b);
 }
 
-// Release a locked buffer.
-// Move to the head of the most-recently-used list.
+// Start writing b's contents to disk, or, if write is 0, reading
+// them from disk, and return without waiting, so that a caller can
+// have many blocks in flight. b must be locked, and stay locked
+// and untouched until bwait(b).
 void
-brelse(struct buf *b)
+bsubmit(struct buf *b, int write)
 {
   if(!holdingsleep(&b->lock))
-    panic("brelse");
+    panic("bsubmit");
+  virtio_disk_start(b, write);
+}
+
+// bsubmit() the n buffers in bufs, all for writing or all for
+// reading. Blocks that are consecutive on the disk go to it in
+// one request of up to MAXRUN blocks; bufs is sorted by block
+// number to find them. bwait() on each buffer afterwards.
+void
+bsubmitv(struct buf **bufs, int n, int write)
+{
+  struct buf *b;
+  int i, j, run;
+
+  // insertion sort; n is at most a log's worth of blocks.
+  for(i = 1; i < n; i++){
+    b = bufs[i];
+    for(j = i; j > 0 && (bufs[j-1]->dev > b->dev ||
+        (bufs[j-1]->dev == b->dev && bufs[j-1]->blockno > b->blockno)); j--)
+      bufs[j] = bufs[j-1];
+    bufs[j] = b;
+  }
+
+  for(i = 0; i < n; i += run){
+    if(!holdingsleep(&bufs[i]->lock))
+      panic("bsubmitv");
+    for(run = 1; i + run < n && run < MAXRUN; run++){
+      b = bufs[i + run];
+      if(b->dev != bufs[i]->dev || b->blockno != bufs[i]->blockno + run)
+        break;
+      if(!holdingsleep(&b->lock))
+        panic("bsubmitv");
+    }
+    virtio_disk_startv(&bufs[i], run, write);
+  }
+}
+
+// Start reading the n blocks in blocks[] of dev into the cache,
+// those that are not there already, and return without waiting.
+// The disk reads adjacent blocks in one request, and releases each
+// buffer with breadaheaddone() when its block is in.
+void
+breadahead(uint dev, uint *blocks, int n)
+{
+  struct buf *b, *bufs[RAMAX];
+  int i, m = 0;
 
+  if(n > RAMAX)
+    n = RAMAX;
+  for(i = 0; i < n; i++){
+    b = bget(dev, blocks[i]);
+    if(b->valid){
+      brelse(b);
+      continue;
+    }
+    b->ahead = 1;
+    bufs[m++] = b;
+  }
+  if(m > 0){
+    __atomic_add_fetch(&bcache.nahead, m, __ATOMIC_RELAXED);
+    bsubmitv(bufs, m, 0);
+  }
+}
+
+// Called by virtio_disk_intr() when a read started by breadahead()
+// is done, on behalf of the process that started it, which did
+// not wait. Interrupts are off; take only spin-locks.
+void
+breadaheaddone(struct buf *b)
+{
+  b->ahead = 0;
+  b->valid = 1;
   releasesleep(&b->lock);
+  bput(b);
+}
 
-  acquire(&bcache.lock);
+// Forget the contents of every unused buffer, so that the next
+// bread() of each block goes to the disk: a cold cache, for
+// benchmarks. Buffers in use keep theirs.
+void
+binval(void)
+{
+  struct buf *b;
+
+  for(int h = 0; h < NBUCKET; h++){
+    acquire(&bcache.bucket[h].lock);
+    for(b = bcache.bucket[h].head; b; b = b->next)
+      if(b->refcnt == 0)
+        b->valid = 0;
+    release(&bcache.bucket[h].lock);
+  }
+}
+
+// Wait for the disk to finish with b, after bsubmit(b).
+// b then holds what is on disk.
+void
+bwait(struct buf *b)
+{
+  virtio_disk_wait(b);
+  b->valid = 1;
+}
+
+// Drop a reference to b. The buffer stays in its bucket while
+// referenced, so this needs only that bucket's lock.
+static void
+bput(struct buf *b)
+{
+  int h = bhash(b->dev, b->blockno), idle;
+
+  acquire(&bcache.bucket[h].lock);
   b->refcnt--;
-  if (b->refcnt == 0) {
+  idle = b->refcnt == 0;
+  if (idle) {
     // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    b->lastuse = r_time();
+  }
+  release(&bcache.bucket[h].lock);
+
+  if(idle && __atomic_load_n(&bcache.nwait, __ATOMIC_ACQUIRE)){
+    acquire(&bcache.lock);
+    wakeup(&bcache.nwait);
+    release(&bcache.lock);
   }
-  
-  release(&bcache.lock);
+}
+
+// Release a locked buffer.
+// Record when, for choosing buffers to recycle.
+void
+brelse(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("brelse");
+
+  releasesleep(&b->lock);
+  bput(b);
 }
 
 void
 bpin(struct buf *b) {
-  acquire(&bcache.lock);
+  int h = bhash(b->dev, b->blockno);
+
+  acquire(&bcache.bucket[h].lock);
   b->refcnt++;
-  release(&bcache.lock);
+  release(&bcache.bucket[h].lock);
 }
 
 void
 bunpin(struct buf *b) {
+  bput(b);
+}
+
+// Fill in the buffer cache statistics for memstats().
+void
+bstats(struct memstats *st)
+{
   acquire(&bcache.lock);
-  b->refcnt--;
+  st->nbuf = bcache.nbuf;
   release(&bcache.lock);
+  st->bufhits = bcache.nhit;
+  st->bufmisses = bcache.nmiss;
+  st->bufahead = bcache.nahead;
 }
-
-
@@ -2,9 +2,12 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct memstats;
 struct pipe;
+struct slabcache;
 struct proc;
 struct spinlock;
+struct vma;
 struct sleeplock;
 struct stat;
 struct superblock;
@@ -14,8 +17,16 @@ void            binit(void);
 struct buf*     bread(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            bsubmit(struct buf*, int);
+void            bsubmitv(struct buf**, int, int);
+void            breadahead(uint, uint*, int);
+void            breadaheaddone(struct buf*);
+void            binval(void);
+void            bwait(struct buf*);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
+int             bshrink(int);
+void            bstats(struct memstats*);
 
 // console.c
 void            consoleinit(void);
@@ -51,6 +62,7 @@ struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, int, uint64, uint, uint);
 void            stati(struct inode*, struct stat*);
+int             setreadahead(int);
 int             writei(struct inode*, int, uint64, uint, uint);
 void            itrunc(struct inode*);
 void            ireclaim(int);
@@ -59,6 +71,14 @@ void            ireclaim(int);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void*           kzalloc(void);
+void*           kallocpages(int);
+void            kfreepages(void *, int);
+void            ksplitpages(void *, int);
+int             kzerofill(void);
+void            kallocstats(struct memstats*);
+void            kdup(void *);
+int             krefs(void *);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -67,6 +87,7 @@ void            begin_op(void);
 void            end_op(void);
 
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
@@ -81,7 +102,7 @@ void            printfinit(void);
 int             cpuid(void);
 void            kexit(int);
 int             kfork(void);
-int             growproc(int);
+int             growproc(int, int);
 void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
@@ -92,9 +113,6 @@ struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            procinit(void);
 void            scheduler(void) __attribute__((noreturn));
-// Add the two scheduler function declarations to the defs header file
-void            scheduler_rrsp(void) __attribute__((noreturn));
-void            scheduler_mlfq(void) __attribute__((noreturn));
 void            sched(void);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
@@ -110,10 +128,17 @@ void             initqueuelevel(struct proc* p);
 // swtch.S
 void            swtch(struct context*, struct context*);
 
+// slab.c
+void            slabinit(struct slabcache*, char*, uint);
+void*           slaballoc(struct slabcache*);
+void            slabfree(struct slabcache*, void*);
+void            slabstats(struct memstats*);
+
 // spinlock.c
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+int             lockstats(uint64, int);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
@@ -141,12 +166,27 @@ int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
 
+// trace.c
+void            traceinit(void);
+void            trace(int, int, int);
+int             traceread(uint64, int);
+
+// timer.c
+void            timerinit(void);
+int             timersleep(uint64);
+void            timerexpire(uint64);
+uint64          timernext(void);
+
 // trap.c
 extern uint     ticks;
 void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
 void            prepare_return(void);
+uint            clockupdate(void);
+uint64          ticktime(uint);
+void            clockarm(int);
+void            cpuwake(int);
 
 // uart.c
 void            uartinit(void);
@@ -162,18 +202,24 @@ void            kvmmap(pagetable_t, uint64, uint64, uint64, int);
 int             mappages(pagetable_t, uint64, uint64, uint64, int);
 pagetable_t     uvmcreate(void);
 uint64          uvmalloc(pagetable_t, uint64, uint64, int);
+uint64          uvmallocmega(pagetable_t, uint64, uint64, int);
+int             mapmega(pagetable_t, uint64, uint64, int);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
+int             uvmsplit(pagetable_t, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
+int             uvmdup(pagetable_t, pagetable_t, uint64, uint64, int);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
 pte_t *         walk(pagetable_t, uint64, int);
+pte_t *         walklevel(pagetable_t, uint64, int, int, int *);
 uint64          walkaddr(pagetable_t, uint64);
 int             copyout(pagetable_t, uint64, char *, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
 int             ismapped(pagetable_t, uint64);
 uint64          vmfault(pagetable_t, uint64, int);
+uint64          cowcopy(pagetable_t, uint64);
 
 // plic.c
 void            plicinit(void);
@@ -181,10 +227,41 @@ void            plicinithart(void);
 int             plic_claim(void);
 void            plic_complete(int);
 
+// swap.c
+void            swapinit(void);
+void*           kallocuser(int);
+uint64          swapin(pagetable_t, uint64);
+void            swapdup(int);
+void            swapput(int);
+void            swapstats(struct memstats*);
+
+// vma.c
+void            vmainit(void);
+int             vmaadd(struct vma*, uint64, uint64, int, int, struct inode*, uint, uint);
+struct vma*     vmafind(struct proc*, uint64);
+int             vmaoverlap(struct proc*, uint64, uint64);
+int             vmafill(struct proc*);
+int             vmadup(struct proc*, struct proc*);
+void            vmadrop(pagetable_t, struct vma*);
+uint64          vmamap(struct proc*, uint64, uint64, int, int, struct inode*, uint, uint);
+int             vmaremove(struct proc*, uint64, uint64);
+uint64          vmafault(pagetable_t, struct vma*, uint64);
+int             textcached(uint, uint);
+void            textinval(struct inode*);
+void            vmastats(struct memstats*);
+
+// zero.c
+void            zeroinit(void);
+
 // virtio_disk.c
 void            virtio_disk_init(void);
 void            virtio_disk_rw(struct buf *, int);
+void            virtio_disk_start(struct buf *, int);
+void            virtio_disk_startv(struct buf **, int, int);
+void            virtio_disk_wait(struct buf *);
+void            virtio_disk_rwpage(uint, void *, int);
 void            virtio_disk_intr(void);
+void            virtio_disk_stats(struct memstats*);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
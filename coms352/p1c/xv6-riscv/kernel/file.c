@@ -12,35 +12,36 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "slab.h"
 
 struct devsw devsw[NDEV];
+
+// Open files come from a slab cache; ftable.lock
+// protects their reference counts.
 struct {
   struct spinlock lock;
-  struct file file[NFILE];
+  struct slabcache cache;
 } ftable;
 
 void
 fileinit(void)
 {
   initlock(&ftable.lock, "ftable");
+  slabinit(&ftable.cache, "file", sizeof(struct file));
 }
 
 // Allocate a file structure.
+// Returns 0 if out of memory.
 struct file*
 filealloc(void)
 {
   struct file *f;
 
-  acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
-    }
-  }
-  release(&ftable.lock);
-  return 0;
+  if((f = slaballoc(&ftable.cache)) == 0)
+    return 0;
+  memset(f, 0, sizeof(*f));
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
@@ -69,9 +70,8 @@ fileclose(struct file *f)
     return;
   }
   ff = *f;
-  f->ref = 0;
-  f->type = FD_NONE;
   release(&ftable.lock);
+  slabfree(&ftable.cache, f);
 
   if(ff.type == FD_PIPE){
     pipeclose(ff.pipe, ff.writable);
@@ -106,6 +106,7 @@ filestat(struct file *f, uint64 addr)
 int
 fileread(struct file *f, uint64 addr, int n)
 {
+  struct proc *p = myproc();
   int r = 0;
 
   if(f->readable == 0)
@@ -118,10 +119,19 @@ fileread(struct file *f, uint64 addr, int n)
       return -1;
     r = devsw[f->major].read(1, addr, n);
   } else if(f->type == FD_INODE){
-    ilock(f->ip);
-    if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
-      f->off += r;
-    iunlock(f->ip);
+    for(;;){
+      ilock(f->ip);
+      p->iolock = f->ip;
+      p->iofault = 0;
+      if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
+        f->off += r;
+      p->iolock = 0;
+      iunlock(f->ip);
+      // a page of another mapped file that vmafault() could not
+      // read in with f->ip locked: fault it in and try again.
+      if(r >= 0 || p->iofault == 0 || vmfault(p->pagetable, p->iofault, 0) == 0)
+        break;
+    }
   } else {
     panic("fileread");
   }
@@ -134,6 +144,7 @@ fileread(struct file *f, uint64 addr, int n)
 int
 filewrite(struct file *f, uint64 addr, int n)
 {
+  struct proc *p = myproc();
   int r, ret = 0;
 
   if(f->writable == 0)
@@ -159,14 +170,22 @@ filewrite(struct file *f, uint64 addr, int n)
 
       begin_op();
       ilock(f->ip);
+      p->iolock = f->ip;
+      p->iofault = 0;
       if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
         f->off += r;
+      p->iolock = 0;
       iunlock(f->ip);
       end_op();
 
       if(r != n1){
-        // error from writei
-        break;
+        // error from writei, or a page of another mapped file
+        // that vmafault() could not read in with f->ip locked:
+        // fault it in and go on from where writei stopped.
+        if(r < 0 || p->iofault == 0 || vmfault(p->pagetable, p->iofault, 1) == 0)
+          break;
+        i += r;
+        continue;
       }
       i += r;
     }
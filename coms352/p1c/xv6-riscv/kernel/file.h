@@ -18,8 +18,13 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *next; // itable list
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
+  int text;           // may have pages in the text page cache
+  uint ranext;        // block a sequential readi() would read next
+  uint raend;         // blocks before this have been read ahead
+  uint rawin;         // read-ahead window, in blocks
 
   short type;         // copy of disk inode
   short major;
@@ -38,3 +43,4 @@ struct devsw {
 extern struct devsw devsw[];
 
 #define CONSOLE 1
+#define ZERO    2
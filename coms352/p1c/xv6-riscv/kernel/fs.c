@@ -20,6 +20,7 @@
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
+#include "slab.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 // there should be one superblock per disk device, but we run with
@@ -166,9 +167,11 @@ bfree(int dev, uint b)
 // multi-step atomic operations.
 //
 // The itable.lock spin-lock protects the allocation of itable
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold itable.lock while using any of those fields.
+// entries. In-use inodes are kept on a list and come from a slab
+// cache: iget() allocates an entry and iput() frees it when ip->ref
+// drops to zero. Since ip->dev and ip->inum indicate which i-node
+// an entry holds, one must hold itable.lock while using ip->ref,
+// ip->dev, ip->inum or ip->next.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
@@ -176,18 +179,15 @@ bfree(int dev, uint b)
 
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *head;   // in-use inodes
+  struct slabcache cache;
 } itable;
 
 void
 iinit()
 {
-  int i = 0;
-  
   initlock(&itable.lock, "itable");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&itable.inode[i].lock, "inode");
-  }
+  slabinit(&itable.cache, "inode", sizeof(struct inode));
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -195,23 +195,30 @@ static struct inode* iget(uint dev, uint inum);
 // Allocate an inode on device dev.
 // Mark it as allocated by  giving it type type.
 // Returns an unlocked but allocated and referenced inode,
-// or NULL if there is no free inode.
+// or NULL if there is no free inode or no memory for it.
 struct inode*
 ialloc(uint dev, short type)
 {
   int inum;
   struct buf *bp;
   struct dinode *dip;
+  struct inode *ip;
 
   for(inum = 1; inum < sb.ninodes; inum++){
     bp = bread(dev, IBLOCK(inum, sb));
     dip = (struct dinode*)bp->data + inum%IPB;
     if(dip->type == 0){  // a free inode
+      // get the in-memory inode first, so that running out of
+      // memory doesn't leave the inode allocated on the disk.
+      if((ip = iget(dev, inum)) == 0){
+        brelse(bp);
+        return 0;
+      }
       memset(dip, 0, sizeof(*dip));
       dip->type = type;
       log_write(bp);   // mark it allocated on the disk
       brelse(bp);
-      return iget(dev, inum);
+      return ip;
     }
     brelse(bp);
   }
@@ -244,34 +251,40 @@ iupdate(struct inode *ip)
 // Find the inode with number inum on device dev
 // and return the in-memory copy. Does not lock
 // the inode and does not read it from disk.
+// Returns 0 if there is no memory for a new entry.
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip;
 
   acquire(&itable.lock);
 
   // Is the inode already in the table?
-  empty = 0;
-  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
+  for(ip = itable.head; ip != 0; ip = ip->next){
+    if(ip->dev == dev && ip->inum == inum){
       ip->ref++;
       release(&itable.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode entry.
-  if(empty == 0)
-    panic("iget: no inodes");
+  // Allocate an inode entry.
+  if((ip = slaballoc(&itable.cache)) == 0){
+    release(&itable.lock);
+    return 0;
+  }
 
-  ip = empty;
+  initsleeplock(&ip->lock, "inode");
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->text = textcached(dev, inum);
+  ip->ranext = 0;
+  ip->raend = 0;
+  ip->rawin = 0;
+  ip->next = itable.head;
+  itable.head = ip;
   release(&itable.lock);
 
   return ip;
@@ -328,8 +341,8 @@ iunlock(struct inode *ip)
 }
 
 // Drop a reference to an in-memory inode.
-// If that was the last reference, the inode table entry can
-// be recycled.
+// If that was the last reference, the inode table entry is
+// freed.
 // If that was the last reference and the inode has no links
 // to it, free the inode (and its content) on disk.
 // All calls to iput() must be inside a transaction in
@@ -337,6 +350,8 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
+  struct inode **pp;
+
   acquire(&itable.lock);
 
   if(ip->ref == 1 && ip->valid && ip->nlink == 0){
@@ -358,8 +373,17 @@ iput(struct inode *ip)
     acquire(&itable.lock);
   }
 
-  ip->ref--;
+  if(--ip->ref > 0){
+    release(&itable.lock);
+    return;
+  }
+
+  // no references left: take ip off the list and free it.
+  for(pp = &itable.head; *pp != ip; pp = &(*pp)->next)
+    ;
+  *pp = ip->next;
   release(&itable.lock);
+  slabfree(&itable.cache, ip);
 }
 
 // Common idiom: unlock, then put.
@@ -452,6 +476,7 @@ itrunc(struct inode *ip)
   struct buf *bp;
   uint *a;
 
+  textinval(ip);
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
       bfree(ip->dev, ip->addrs[i]);
@@ -472,6 +497,9 @@ itrunc(struct inode *ip)
   }
 
   ip->size = 0;
+  ip->ranext = 0;
+  ip->raend = 0;
+  ip->rawin = 0;
   iupdate(ip);
 }
 
@@ -487,6 +515,64 @@ stati(struct inode *ip, struct stat *st)
   st->size = ip->size;
 }
 
+#define RAMIN 4   // blocks read ahead at the start of a sequential read
+
+static int ramax = RAMAX;   // set by setreadahead()
+
+// A readi() of blocks first to last of ip is about to read them.
+// If it carries on where the last one left off, read ahead:
+// start reading the blocks from first up to a window past last,
+// those not already started, without waiting, so that the disk
+// reads them, in a few multi-block requests, while the reader
+// copies out the ones before. The window starts at RAMIN blocks
+// and doubles up to ramax each time the reader gets within half
+// a window of the end of what was read ahead. A readi() anywhere
+// else in the file closes the window.
+// Caller must hold ip->lock.
+static void
+readahead(struct inode *ip, uint first, uint last)
+{
+  uint blocks[RAMAX], bn, end, nblocks, addr;
+  int n = 0;
+
+  // the same block again counts as sequential: small reads.
+  if(ramax == 0 || (first != ip->ranext && first + 1 != ip->ranext)){
+    ip->ranext = last + 1;
+    ip->raend = 0;
+    ip->rawin = 0;
+    return;
+  }
+  ip->ranext = last + 1;
+  if(ip->raend < first)
+    ip->raend = first;
+  if(ip->rawin > 0 && ip->raend > last && ip->raend - (last + 1) >= ip->rawin / 2)
+    return;   // far enough ahead
+
+  ip->rawin = ip->rawin ? min(2 * ip->rawin, ramax) : min(RAMIN, ramax);
+  nblocks = (ip->size + BSIZE - 1) / BSIZE;
+  end = min(last + 1 + ip->rawin, nblocks);
+  for(bn = ip->raend; bn < end && n < RAMAX; bn++){
+    if((addr = bmap(ip, bn)) == 0)
+      break;
+    blocks[n++] = addr;
+  }
+  ip->raend = bn;
+  if(n > 0)
+    breadahead(ip->dev, blocks, n);
+}
+
+// Set the most blocks readi() reads ahead, at most RAMAX; 0 turns
+// read-ahead off, and -1 leaves it. Returns the old setting.
+int
+setreadahead(int max)
+{
+  int old = ramax;
+
+  if(max >= 0)
+    ramax = min(max, RAMAX);
+  return old;
+}
+
 // Read data from inode.
 // Caller must hold ip->lock.
 // If user_dst==1, then dst is a user virtual address;
@@ -501,6 +587,8 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
     return 0;
   if(off + n > ip->size)
     n = ip->size - off;
+  if(n > 0)
+    readahead(ip, off/BSIZE, (off + n - 1)/BSIZE);
 
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
     uint addr = bmap(ip, off/BSIZE);
@@ -535,6 +623,7 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
     return -1;
   if(off + n > MAXFILE*BSIZE)
     return -1;
+  textinval(ip);
 
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
     uint addr = bmap(ip, off/BSIZE);
@@ -571,6 +660,7 @@ namecmp(const char *s, const char *t)
 
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
+// Returns 0 if not found, or if iget() has no memory for it.
 struct inode*
 dirlookup(struct inode *dp, char *name, uint *poff)
 {
@@ -676,9 +766,10 @@ namex(char *path, int nameiparent, char *name)
 {
   struct inode *ip, *next;
 
-  if(*path == '/')
-    ip = iget(ROOTDEV, ROOTINO);
-  else
+  if(*path == '/'){
+    if((ip = iget(ROOTDEV, ROOTINO)) == 0)
+      return 0;
+  } else
     ip = idup(myproc()->cwd);
 
   while((path = skipelem(path, name)) != 0){
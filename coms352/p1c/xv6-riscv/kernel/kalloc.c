@@ -1,6 +1,24 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates whole 4096-byte pages,
+// or with kallocpages() blocks of 2^order contiguous pages.
+//
+// The global pool is a buddy allocator: a free list per order,
+// where a block of order k is 2^k pages aligned to its size.
+// Allocating splits a larger block if needed; freeing merges
+// a block with its buddy whenever the buddy is free too.
+//
+// Each CPU keeps a cache of free pages, so that kalloc() and
+// kfree() usually touch only this CPU's list. A cache that runs
+// dry refills KBATCH pages from the global pool (or, if that is
+// empty, takes half of another CPU's cache); a cache that grows
+// to KCACHE pages spills KBATCH of them back to the global pool.
+//
+// Pages shared by copy-on-write fork carry a reference count;
+// kfree() only frees a page when its last reference goes away.
+//
+// Idle CPUs zero free pages ahead of time (kzerofill()), so that
+// kzalloc() can usually hand out a zeroed page without a memset.
 
 #include "types.h"
 #include "param.h"
@@ -8,25 +26,70 @@
 #include "spinlock.h"
 #include "riscv.h"
 #include "defs.h"
+#include "memstat.h"
+
+#define KCACHE 64   // most pages a per-CPU cache holds
+#define KBATCH 32   // pages moved per refill or spill
+#define KZERO  64   // most pages kept zeroed ahead of time
 
 void freerange(void *pa_start, void *pa_end);
+static void buddyfree(void *pa, int k);
 
 extern char end[]; // first address after kernel.
                    // defined by kernel.ld.
 
 struct run {
   struct run *next;
+  struct run *prev;   // only used on the buddy free lists
 };
 
+#define NPAGE ((PHYSTOP - KERNBASE) / PGSIZE)
+
 struct {
   struct spinlock lock;
-  struct run *freelist;
+  struct run *free[NORDER];   // free blocks of each order
+  int nfree[NORDER];
+  // for the first page of a free block of order k, k+1;
+  // 0 for every other page.
+  uchar order[NPAGE];
 } kmem;
 
+// A CPU's lock is only contended when another CPU steals from it.
+// Aligned so that CPUs do not share cache lines.
+struct kcache {
+  struct spinlock lock;
+  struct run *freelist;
+  int n;
+  uint64 nalloc;
+  uint64 nrefill;
+  uint64 nspill;
+  uint64 nsteal;
+} __attribute__((aligned(64)));
+
+struct kcache kcache[NCPU];
+
+// Pages zeroed by idle CPUs.
+struct {
+  struct spinlock lock;
+  struct run *freelist;
+  int n;
+  uint64 nhit;
+  uint64 nmiss;
+} kzero;
+
+// References to each physical page above KERNBASE, updated
+// with atomic instructions so that no lock is needed.
+#define PA2REF(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+#define REF2PA(i)  ((struct run *)(KERNBASE + (uint64)(i) * PGSIZE))
+static int kref[NPAGE];
+
 void
 kinit()
 {
   initlock(&kmem.lock, "kmem");
+  initlock(&kzero.lock, "kzero");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&kcache[i].lock, "kcache");
   freerange(end, (void*)PHYSTOP);
 }
 
@@ -35,30 +98,266 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
+  acquire(&kmem.lock);
   for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
-    kfree(p);
+    buddyfree(p, 0);
+  release(&kmem.lock);
+}
+
+static void
+buddypush(uint64 i, int k)
+{
+  struct run *r = REF2PA(i);
+
+  r->prev = 0;
+  r->next = kmem.free[k];
+  if(r->next)
+    r->next->prev = r;
+  kmem.free[k] = r;
+  kmem.nfree[k]++;
+  kmem.order[i] = k + 1;
+}
+
+static void
+buddyunlink(uint64 i, int k)
+{
+  struct run *r = REF2PA(i);
+
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.free[k] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.nfree[k]--;
+  kmem.order[i] = 0;
+}
+
+// Return a block of 2^k pages to the free lists, merging it
+// with its buddy as long as the buddy is free and whole.
+// Caller holds kmem.lock.
+static void
+buddyfree(void *pa, int k)
+{
+  uint64 i = PA2REF(pa), b;
+
+  for(; k < NORDER - 1; k++){
+    b = i ^ (1L << k);
+    if(b >= NPAGE || kmem.order[b] != k + 1)
+      break;
+    buddyunlink(b, k);
+    i &= ~(1L << k);
+  }
+  buddypush(i, k);
 }
 
-// Free the page of physical memory pointed at by pa,
-// which normally should have been returned by a
+// Take a block of 2^k pages from the free lists, splitting
+// the smallest larger block if there is none of order k.
+// Returns 0 if no block is big enough. Caller holds kmem.lock.
+static void *
+buddyalloc(int k)
+{
+  uint64 i;
+  int j;
+
+  for(j = k; j < NORDER && kmem.free[j] == 0; j++)
+    ;
+  if(j == NORDER)
+    return 0;
+  i = PA2REF(kmem.free[j]);
+  buddyunlink(i, j);
+  // keep the first half of each split, free the second
+  while(j > k){
+    j--;
+    buddypush(i + (1L << j), j);
+  }
+  return REF2PA(i);
+}
+
+// Detach the first n pages of list *head, which must hold
+// at least n. Returns them, with *tail set to the last one.
+static struct run *
+takepages(struct run **head, int n, struct run **tail)
+{
+  struct run *first, *r;
+
+  first = r = *head;
+  for(int i = 1; i < n; i++)
+    r = r->next;
+  *head = r->next;
+  r->next = 0;
+  *tail = r;
+  return first;
+}
+
+// Refill an empty cache, kc, belonging to this CPU.
+// Caller has interrupts off and does not hold kc->lock.
+static void
+krefill(struct kcache *kc)
+{
+  struct run *first = 0, *last = 0, *r;
+  struct kcache *victim;
+  int n = 0, stolen = 0;
+
+  acquire(&kmem.lock);
+  for(; n < KBATCH && (r = buddyalloc(0)) != 0; n++){
+    if(n == 0)
+      last = r;
+    r->next = first;
+    first = r;
+  }
+  release(&kmem.lock);
+
+  // Global pool is empty: take half of the first
+  // other CPU's cache that has pages.
+  for(int i = 1; n == 0 && i < NCPU; i++){
+    victim = &kcache[(kc - kcache + i) % NCPU];
+    acquire(&victim->lock);
+    if(victim->n > 0){
+      n = (victim->n + 1) / 2;
+      first = takepages(&victim->freelist, n, &last);
+      victim->n -= n;
+      stolen = 1;
+    }
+    release(&victim->lock);
+  }
+
+  if(n == 0)
+    return;
+
+  acquire(&kc->lock);
+  last->next = kc->freelist;
+  kc->freelist = first;
+  kc->n += n;
+  kc->nrefill++;
+  kc->nsteal += stolen;
+  release(&kc->lock);
+}
+
+// Add a reference to an allocated page.
+void
+kdup(void *pa)
+{
+  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+    panic("kdup");
+  __atomic_add_fetch(&kref[PA2REF(pa)], 1, __ATOMIC_RELAXED);
+}
+
+// Number of references to an allocated page.
+int
+krefs(void *pa)
+{
+  return __atomic_load_n(&kref[PA2REF(pa)], __ATOMIC_ACQUIRE);
+}
+
+// Drop a reference to the page of physical memory pointed
+// at by pa, and free it if that was the last one. pa
+// normally should have been returned by a
 // call to kalloc().  (The exception is when
 // initializing the allocator; see kinit above.)
 void
 kfree(void *pa)
 {
-  struct run *r;
+  struct run *r, *spill = 0, *last;
+  struct kcache *kc;
+  int n;
 
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
+  n = __atomic_sub_fetch(&kref[PA2REF(pa)], 1, __ATOMIC_ACQ_REL);
+  if(n > 0)
+    return;
+  if(n < 0)
+    panic("kfree: ref");
+
+#if KDEBUG
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
+#endif
 
   r = (struct run*)pa;
 
+  push_off();
+  kc = &kcache[cpuid()];
+  acquire(&kc->lock);
+  r->next = kc->freelist;
+  kc->freelist = r;
+  kc->n++;
+  if(kc->n >= KCACHE){
+    spill = takepages(&kc->freelist, KBATCH, &last);
+    kc->n -= KBATCH;
+    kc->nspill++;
+  }
+  release(&kc->lock);
+
+  if(spill){
+    acquire(&kmem.lock);
+    while(spill){
+      r = spill;
+      spill = r->next;
+      buddyfree(r, 0);
+    }
+    release(&kmem.lock);
+  }
+  pop_off();
+}
+
+// Allocate 2^order physically contiguous pages, aligned to
+// their size, for order < NORDER. Order 0 is kalloc().
+// Returns 0 if the memory cannot be allocated.
+void *
+kallocpages(int order)
+{
+  void *pa;
+
+  if(order < 0 || order >= NORDER)
+    panic("kallocpages");
+  if(order == 0)
+    return kalloc();
+
   acquire(&kmem.lock);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
+  pa = buddyalloc(order);
+  release(&kmem.lock);
+  if(pa){
+    kref[PA2REF(pa)] = 1;
+#if KDEBUG
+    memset(pa, 5, PGSIZE << order); // fill with junk
+#endif
+  }
+  return pa;
+}
+
+// Turn a block from kallocpages(order) into 2^order pages
+// that can each be shared and freed with kfree() on their own.
+void
+ksplitpages(void *pa, int order)
+{
+  for(int i = 1; i < (1 << order); i++)
+    kref[PA2REF(pa) + i] = 1;
+}
+
+// Free 2^order pages allocated by kallocpages(order).
+void
+kfreepages(void *pa, int order)
+{
+  if(order == 0){
+    kfree(pa);
+    return;
+  }
+  if(order < 0 || order >= NORDER ||
+     ((uint64)pa % (PGSIZE << order)) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+    panic("kfreepages");
+  if(__atomic_sub_fetch(&kref[PA2REF(pa)], 1, __ATOMIC_ACQ_REL) != 0)
+    panic("kfreepages: ref");
+
+#if KDEBUG
+  // Fill with junk to catch dangling refs.
+  memset(pa, 1, PGSIZE << order);
+#endif
+
+  acquire(&kmem.lock);
+  buddyfree(pa, order);
   release(&kmem.lock);
 }
 
@@ -69,14 +368,124 @@ void *
 kalloc(void)
 {
   struct run *r;
+  struct kcache *kc;
 
-  acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
-  release(&kmem.lock);
+  push_off();
+  kc = &kcache[cpuid()];
+  acquire(&kc->lock);
+  if(kc->freelist == 0){
+    release(&kc->lock);
+    krefill(kc);
+    acquire(&kc->lock);
+  }
+  r = kc->freelist;
+  if(r){
+    kc->freelist = r->next;
+    kc->n--;
+    kc->nalloc++;
+  }
+  release(&kc->lock);
+  pop_off();
+
+  // Out of free pages: use up the zeroed ones.
+  if(r == 0){
+    acquire(&kzero.lock);
+    r = kzero.freelist;
+    if(r){
+      kzero.freelist = r->next;
+      kzero.n--;
+    }
+    release(&kzero.lock);
+  }
 
-  if(r)
+  if(r){
+    kref[PA2REF(r)] = 1;
+#if KDEBUG
     memset((char*)r, 5, PGSIZE); // fill with junk
+#endif
+  }
+  return (void*)r;
+}
+
+// Allocate one zeroed 4096-byte page, taking it from the
+// pages idle CPUs have zeroed if there are any.
+// Returns 0 if the memory cannot be allocated.
+void *
+kzalloc(void)
+{
+  struct run *r;
+
+  acquire(&kzero.lock);
+  r = kzero.freelist;
+  if(r){
+    kzero.freelist = r->next;
+    kzero.n--;
+    kzero.nhit++;
+  } else {
+    kzero.nmiss++;
+  }
+  release(&kzero.lock);
+
+  if(r){
+    kref[PA2REF(r)] = 1;
+    r->next = 0;  // the only word the list touched
+    return (void*)r;
+  }
+  if((r = kalloc()) != 0)
+    memset((char*)r, 0, PGSIZE);
   return (void*)r;
 }
+
+// Zero one free page for kzalloc(). Called by idle CPUs.
+// Returns 1 if it zeroed a page, 0 if there are enough
+// zeroed pages already or no free pages.
+int
+kzerofill(void)
+{
+  struct run *r;
+
+  if(kzero.n >= KZERO)
+    return 0;
+  if((r = kalloc()) == 0)
+    return 0;
+  memset((char*)r, 0, PGSIZE);
+
+  // A page waiting in the pool is free, not referenced.
+  kref[PA2REF(r)] = 0;
+  acquire(&kzero.lock);
+  r->next = kzero.freelist;
+  kzero.freelist = r;
+  kzero.n++;
+  release(&kzero.lock);
+  return 1;
+}
+
+// Sum the allocator statistics over the global pool and all caches.
+void
+kallocstats(struct memstats *st)
+{
+  struct kcache *kc;
+
+  memset(st, 0, sizeof(*st));
+  acquire(&kmem.lock);
+  for(int k = 0; k < NORDER; k++){
+    st->nfree[k] = kmem.nfree[k];
+    st->freepages += (uint64)kmem.nfree[k] << k;
+  }
+  release(&kmem.lock);
+  for(kc = kcache; kc < &kcache[NCPU]; kc++){
+    acquire(&kc->lock);
+    st->cached += kc->n;
+    st->nalloc += kc->nalloc;
+    st->nrefill += kc->nrefill;
+    st->nspill += kc->nspill;
+    st->nsteal += kc->nsteal;
+    release(&kc->lock);
+  }
+  acquire(&kzero.lock);
+  st->zeroed = kzero.n;
+  st->nzerohit = kzero.nhit;
+  st->nzeromiss = kzero.nmiss;
+  release(&kzero.lock);
+  st->freepages += st->cached + st->zeroed;
+}
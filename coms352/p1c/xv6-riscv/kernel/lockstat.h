@@ -0,0 +1,10 @@
+// Spin-lock statistics, returned by lockstats(): one entry per
+// lock name, summed over all the locks with that name.
+
+struct lockstat {
+  char name[16];
+  uint nlocks;          // locks with this name
+  uint64 nacquire;      // acquire() calls
+  uint64 ncontend;      // acquire() calls that found the lock held
+  uint64 nspin;         // times around the spin loop in those calls
+};
@@ -28,7 +28,10 @@
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+// A commit writes all the log blocks at once, in a few
+// multi-block disk requests, waits for them, and then writes
+// the header; installing the blocks to their home locations
+// works the same way, a request per run of adjacent blocks.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
@@ -66,6 +69,7 @@ initlog(int dev, struct superblock *sb)
 static void
 install_trans(int recovering)
 {
+  struct buf *dbuf[LOGBLOCKS];
   int tail;
 
   for (tail = 0; tail < log.lh.n; tail++) {
@@ -73,13 +77,16 @@ install_trans(int recovering)
       printf("recovering tail %d dst %d\n", tail, log.lh.block[tail]);
     }
     struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    if(recovering == 0)
-      bunpin(dbuf);
+    dbuf[tail] = bread(log.dev, log.lh.block[tail]); // read dst
+    memmove(dbuf[tail]->data, lbuf->data, BSIZE);  // copy block to dst
     brelse(lbuf);
-    brelse(dbuf);
+  }
+  bsubmitv(dbuf, log.lh.n, 1);  // write dsts to disk, in runs
+  for (tail = 0; tail < log.lh.n; tail++) {
+    bwait(dbuf[tail]);
+    if(recovering == 0)
+      bunpin(dbuf[tail]);
+    brelse(dbuf[tail]);
   }
 }
 
@@ -179,15 +186,19 @@ end_op(void)
 static void
 write_log(void)
 {
+  struct buf *to[LOGBLOCKS];
   int tail;
 
   for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
+    to[tail] = bread(log.dev, log.start+tail+1); // log block
     struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
+    memmove(to[tail]->data, from->data, BSIZE);
     brelse(from);
-    brelse(to);
+  }
+  bsubmitv(to, log.lh.n, 1);  // write the log, MAXRUN blocks at a time
+  for (tail = 0; tail < log.lh.n; tail++) {
+    bwait(to[tail]);
+    brelse(to[tail]);
   }
 }
 
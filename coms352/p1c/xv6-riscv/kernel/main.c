@@ -19,14 +19,20 @@ main()
     kinit();         // physical page allocator
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
+    vmainit();       // text page cache
+    swapinit();      // swap space
     procinit();      // process table
+    traceinit();     // scheduler trace log
     trapinit();      // trap vectors
+    timerinit();     // timer events
     trapinithart();  // install kernel trap vector
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
     binit();         // buffer cache
     iinit();         // inode table
     fileinit();      // file table
+    zeroinit();      // zero device
+    pipeinit();      // pipe cache
     virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
     __sync_synchronize();
@@ -40,14 +46,6 @@ main()
     trapinithart();   // install kernel trap vector
     plicinithart();   // ask PLIC for device interrupts
   }
-  // If statement to set the schedule properly
-  // Used #if over if because (according to some googling)
-  // #if will be removed by compiler if it is seen as unnecessary
-  #if SCHEDULER == SCHED_RR
-    scheduler();
-  #elif SCHEDULER == SCHED_RRSP
-    scheduler_rrsp();
-  #elif SCHEDULER == SCHED_MLFQ
-    scheduler_mlfq();
-  #endif        
+  // The scheduling policy is chosen at run time (see sched_policy in proc.c)
+  scheduler();        
 }
@@ -0,0 +1,43 @@
+// Physical page allocator statistics, returned by memstats().
+// freepages counts the zeroed pages too.
+
+#define NORDER 10   // buddy block orders: 2^0 to 2^9 pages
+#define NSLAB  8    // most slab caches memstats() reports
+
+struct slabinfo {
+  char name[16];
+  uint size;            // object size in bytes
+  uint perslab;         // objects per slab
+  uint64 pages;         // pages held by the cache's slabs
+  uint64 inuse;         // objects allocated
+};
+
+struct memstats {
+  uint64 freepages;     // free pages, in the global pool and all caches
+  uint64 cached;        // free pages in per-CPU caches
+  uint64 nalloc;        // kalloc() calls that returned a page
+  uint64 nrefill;       // per-CPU cache refills from the global pool
+  uint64 nspill;        // per-CPU cache spills to the global pool
+  uint64 nsteal;        // refills taken from another CPU's cache
+  uint64 zeroed;        // free pages zeroed ahead of time by idle CPUs
+  uint64 nzerohit;      // kzalloc() calls served a pre-zeroed page
+  uint64 nzeromiss;     // kzalloc() calls that had to zero a page
+  uint64 nfree[NORDER]; // free blocks of each order in the global pool
+  uint64 filefaults;    // pages of executables read in on first touch
+  uint64 texthits;      // text faults served by a page another process read
+  uint64 textpages;     // read-only file pages cached for sharing
+  uint64 swapsize;      // pages of swap space
+  uint64 swapused;      // swap pages holding paged-out pages
+  uint64 swapins;       // pages read back from swap
+  uint64 swapouts;      // pages written to swap
+  uint64 swapdrops;     // clean file pages dropped instead
+  uint64 nbuf;          // buffers in the disk block cache
+  uint64 bufhits;       // bread()s of a block already in the cache
+  uint64 bufmisses;     // bread()s that went to the disk
+  uint64 bufahead;      // blocks readi() read ahead
+  uint64 diskreqs;      // virtio disk requests
+  uint64 diskblocks;    // blocks they moved
+  uint64 diskintrs;     // virtio disk interrupts
+  int nslab;            // slab caches in use
+  struct slabinfo slab[NSLAB];
+};
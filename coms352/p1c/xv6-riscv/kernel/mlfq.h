@@ -0,0 +1,13 @@
+// MLFQ tunables, read and set with mlfqtune().
+
+#define NMLFQ 3   // queue levels: 2 (highest), 1, 0 (lowest)
+
+struct mlfqparams {
+  int quantum[NMLFQ];  // ticks a process may use at each level before
+                       // it is demoted; Q0, the lowest, never demotes,
+                       // and its quantum is a time slice instead
+  int boost;           // ticks between priority boosts
+  int adaptive;        // if non-zero, adapt boost to the workload
+  int starve;          // adaptive: ticks a Q0 process may wait before
+                       // it counts as starving
+};
@@ -1,21 +1,30 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NVMA         16  // exec segments and mmap() regions per process
+#define NLOCKSTAT   512  // spin-locks lockstats() reports on
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGBLOCKS    (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
+#define NBUF         (MAXOPBLOCKS*3)  // disk block cache buffers always kept
+#define NBUFMAX      2048  // most buffers the cache grows to (2 MiB of blocks)
+#define MAXRUN       16    // most consecutive blocks in one disk request
+#define RAMAX        32    // most blocks readi() reads ahead
 #define FSSIZE       2000  // size of file system in blocks
+#define NSWAP        4096  // pages of swap space, on disk after the file system
 #define MAXPATH      128   // maximum file path name
 #define USERSTACK    1     // user stack pages
+#define TIMEFREQ     10000000  // r_time() cycles per second (qemu virt)
+#define TICKCYCLES   1000000   // r_time() cycles per clock tick
+#define IDLETICKS    10    // longest an idle CPU sleeps, in ticks
 
 // Create a definition for each of the scheduler choices
 #define SCHED_RR		0
 #define SCHED_RRSP		1
 #define SCHED_MLFQ		2
-// Choose which scheduling algorithm we will actually use
+#define SCHED_CFS		3
+// Choose which scheduling algorithm we will use at boot
+// (setscheduler() can switch it on a running kernel)
 #define SCHEDULER		SCHED_RRSP
\ No newline at end of file
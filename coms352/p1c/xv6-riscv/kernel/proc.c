@@ -5,6 +5,9 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "trace.h"
+#include "pstat.h"
+#include "mlfq.h"
 
 // Macros to make finding max and min of two ints easier
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
@@ -16,6 +19,30 @@ int LOGGING_ENABLED;
 // Static variable to keep track of how long it has been since we priority boosted
 static int last_boost_time = 0;
 
+// MLFQ quanta and boost period, changed with mlfqtune()
+static struct mlfqparams mlfq = {
+  .quantum = { 15, 10, 1 },   // Q0, Q1, Q2
+  .boost = 60,
+  .adaptive = 0,
+  .starve = 30,
+};
+
+// Bounds on the boost period in adaptive mode
+#define MINBOOST 10
+#define MAXBOOST 600
+
+// Processes demoted since the last boost; if none were,
+// a boost has nothing to do.
+static int mlfq_demoted;
+
+// Wakeups from sleep since the last boost; adaptive mode
+// lengthens the boost period only if there were none.
+static int mlfq_wakeups;
+
+// The scheduling policy in effect (SCHED_RR, SCHED_RRSP, SCHED_MLFQ or SCHED_CFS).
+// Starts as SCHEDULER from param.h; setscheduler() changes it.
+int sched_policy = SCHEDULER;
+
 struct cpu cpus[NCPU];
 
 struct proc proc[NPROC];
@@ -27,6 +54,8 @@ struct spinlock pid_lock;
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static int runqadd(struct proc *p, struct runq *rq);
+static int runqdel(struct proc *p);
 
 extern char trampoline[]; // trampoline.S
 
@@ -58,9 +87,12 @@ void
 procinit(void)
 {
   struct proc *p;
+  struct cpu *c;
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    initlock(&c->rq.lock, "runq");
   // Initialize logging flag to false
   LOGGING_ENABLED = 0;
   for(p = proc; p < &proc[NPROC]; p++) {
@@ -158,6 +190,17 @@ found:
   p->context.ra = (uint64)forkret;
   p->context.sp = p->kstack + PGSIZE;
 
+  // Start on CPU 0's run queue until fork() places the process.
+  p->cpu = 0;
+
+  // CFS moves this up to its run queue's minimum when it is queued.
+  p->vruntime = 0;
+
+  // Fresh statistics
+  p->statetime = r_time();
+  p->runtime = p->waittime = p->sleeptime = 0;
+  p->nvcsw = p->nivcsw = p->ndemote = 0;
+
   // Ensure the nice value is initialized to 0 (neutral)
   // And call the init queue level function to properly assign queue
   p->nice = 0;
@@ -168,8 +211,13 @@ found:
 
 // A simple function that takes a process pointer and assignes it the correct queue level
 // It also sets the runtime in the queue to 0 to keep things fresh
+// If the process is waiting on a run queue it is moved to the tail of its new level.
+// Caller must hold p->lock.
 void
 initqueuelevel(struct proc* p) {
+  struct runq *rq = p->rq;
+  int queued = runqdel(p);
+
   if (p->nice <= -10) {
     p->queue_level = 2;
   }
@@ -180,6 +228,316 @@ initqueuelevel(struct proc* p) {
     p->queue_level = 0;
   }
   p->runtime_in_queue = 0;
+
+  if (queued) {
+    runqadd(p, rq);
+  }
+}
+
+// CFS load weight for each nice value, -20 through 19, from Linux
+// (sched_prio_to_weight). Each step is about 1.25x, so one nice level
+// changes a process's CPU share by about 10%.
+static const int nice_to_weight[40] = {
+ /* -20 */ 88761, 71755, 56483, 46273, 36291,
+ /* -15 */ 29154, 23254, 18705, 14949, 11916,
+ /* -10 */  9548,  7620,  6100,  4904,  3906,
+ /*  -5 */  3121,  2501,  1991,  1586,  1277,
+ /*   0 */  1024,   820,   655,   526,   423,
+ /*   5 */   335,   272,   215,   172,   137,
+ /*  10 */   110,    87,    70,    56,    45,
+ /*  15 */    36,    29,    23,    18,    15,
+};
+
+// Charge p for the time since it was dispatched. Under CFS its
+// virtual runtime grows inversely to its weight, so a process with
+// twice the weight gets twice the CPU before it falls behind.
+// Caller must hold p->lock, and p must not be on a run queue.
+static void
+accountrun(struct proc *p)
+{
+  uint64 now = r_time();
+  uint64 delta = now - p->runstart;
+
+  p->vruntime += delta * nice_to_weight[20] / nice_to_weight[p->nice + 20];
+  p->runstart = now;
+}
+
+// Order processes in the CFS heap; the comparison is done on the
+// difference so that it stays correct if vruntime wraps.
+static int
+vruntime_before(struct proc *a, struct proc *b)
+{
+  return (long)(a->vruntime - b->vruntime) < 0;
+}
+
+// Put heap slot i, holding p, in its place by moving it up.
+static void
+heapup(struct runq *rq, int i, struct proc *p)
+{
+  while(i > 0){
+    int parent = (i - 1) / 2;
+    if(!vruntime_before(p, rq->heap[parent]))
+      break;
+    rq->heap[i] = rq->heap[parent];
+    rq->heap[i]->heapidx = i;
+    i = parent;
+  }
+  rq->heap[i] = p;
+  p->heapidx = i;
+}
+
+// Put heap slot i, holding p, in its place by moving it down.
+static void
+heapdown(struct runq *rq, int i, struct proc *p)
+{
+  for(;;){
+    int child = 2*i + 1;
+    if(child >= rq->nheap)
+      break;
+    if(child + 1 < rq->nheap && vruntime_before(rq->heap[child+1], rq->heap[child]))
+      child++;
+    if(!vruntime_before(rq->heap[child], p))
+      break;
+    rq->heap[i] = rq->heap[child];
+    rq->heap[i]->heapidx = i;
+    i = child;
+  }
+  rq->heap[i] = p;
+  p->heapidx = i;
+}
+
+// The run queue level p waits at under the current policy;
+// lower levels run first.
+static int
+runqlevel(struct proc *p)
+{
+  switch(sched_policy){
+  case SCHED_CFS:
+    return RQ_HEAP;
+  case SCHED_MLFQ:
+    return 2 - p->queue_level;
+  case SCHED_RRSP:
+    // Priority is 20 - nice, so nice -20 (priority 40) is level 0
+    // and nice 19 (priority 1) is level 39.
+    return p->nice + 20;
+  default:
+    return 0;
+  }
+}
+
+// Index of the lowest set bit of x, which must be non-zero.
+// Uses a de Bruijn sequence rather than __builtin_ctzll(),
+// which may need libgcc on cores without the Zbb extension.
+static int
+lowbit(uint64 x)
+{
+  static const char index64[64] = {
+     0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+    62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+    63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+    46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6
+  };
+  return index64[((x & -x) * 0x03f79d71b4cb0a89ULL) >> 58];
+}
+
+// Append p to the tail of its level on rq.
+// Caller must hold p->lock, and p must be RUNNABLE.
+// Returns 1 if rq's CPU was idle in wfi and must be woken.
+static int
+runqadd(struct proc *p, struct runq *rq)
+{
+  int idle;
+
+  int level = runqlevel(p);
+
+  acquire(&rq->lock);
+  if(p->rq)
+    panic("runqadd");
+  if(level == RQ_HEAP){
+    // A process that slept or is new does not get to bank the time
+    // it was away; it competes from the current minimum.
+    if((long)(p->vruntime - rq->min_vruntime) < 0)
+      p->vruntime = rq->min_vruntime;
+    heapup(rq, rq->nheap++, p);
+  } else {
+    p->rq_next = 0;
+    p->rq_prev = rq->tail[level];
+    if(rq->tail[level])
+      rq->tail[level]->rq_next = p;
+    else
+      rq->head[level] = p;
+    rq->tail[level] = p;
+    rq->mask |= 1ULL << level;
+  }
+  p->rq = rq;
+  p->rq_level = level;
+  rq->n++;
+  idle = rq->idle;
+  rq->idle = 0;
+  release(&rq->lock);
+  return idle;
+}
+
+// Unlink p from rq. Caller must hold rq->lock.
+// Uses the level p was queued at, since its nice value
+// may have changed since then.
+static void
+runqunlink(struct runq *rq, struct proc *p)
+{
+  int level = p->rq_level;
+
+  if(level == RQ_HEAP){
+    // Fill the hole with the last element and restore the heap.
+    struct proc *last = rq->heap[--rq->nheap];
+    if(last != p){
+      heapup(rq, p->heapidx, last);
+      heapdown(rq, last->heapidx, last);
+    }
+    rq->heap[rq->nheap] = 0;
+    p->heapidx = 0;
+  } else {
+    if(p->rq_prev)
+      p->rq_prev->rq_next = p->rq_next;
+    else
+      rq->head[level] = p->rq_next;
+    if(p->rq_next)
+      p->rq_next->rq_prev = p->rq_prev;
+    else
+      rq->tail[level] = p->rq_prev;
+    if(rq->head[level] == 0)
+      rq->mask &= ~(1ULL << level);
+  }
+  p->rq_next = p->rq_prev = 0;
+  p->rq = 0;
+  rq->n--;
+}
+
+// Unlink p from its run queue, if it is on one.
+// Returns 1 if p was queued, 0 otherwise.
+// Caller must hold p->lock. Since a queued process is only
+// ever added with its lock held, p->rq can change under us
+// only by another CPU popping p off to run it.
+static int
+runqdel(struct proc *p)
+{
+  struct runq *rq = p->rq;
+  int queued = 0;
+
+  if(rq == 0)
+    return 0;
+  acquire(&rq->lock);
+  if(p->rq == rq){
+    runqunlink(rq, p);
+    queued = 1;
+  }
+  release(&rq->lock);
+  return queued;
+}
+
+// Choose the next process to run from rq and unlink it,
+// or return 0 if rq is empty. Caller must hold rq->lock.
+// Strict priority between levels and round-robin within a level
+// both follow from always popping the head of the highest
+// non-empty level and re-adding at the tail. CFS runs the
+// process with the smallest virtual runtime.
+// Just after a policy change both kinds may be queued.
+static struct proc*
+runqpick(struct runq *rq)
+{
+  struct proc *p;
+
+  if(rq->mask != 0){
+    p = rq->head[lowbit(rq->mask)];
+  } else if(rq->nheap > 0){
+    p = rq->heap[0];
+    if((long)(p->vruntime - rq->min_vruntime) > 0)
+      rq->min_vruntime = p->vruntime;
+  } else {
+    return 0;
+  }
+  runqunlink(rq, p);
+  return p;
+}
+
+// Find the next process for CPU c to run: first from its own
+// run queue, then by stealing from the CPU with the most
+// queued processes. Returns 0 if nothing is runnable anywhere.
+// The caller must then acquire p->lock before running it;
+// a process that is still switching out (e.g. in yield())
+// holds its lock until its context has been saved.
+static struct proc*
+runqpop(struct cpu *c)
+{
+  struct proc *p;
+  struct cpu *victim, *v;
+
+  acquire(&c->rq.lock);
+  p = runqpick(&c->rq);
+  release(&c->rq.lock);
+  if(p)
+    return p;
+
+  // Idle: steal from the busiest CPU. The unlocked reads of
+  // rq.n are only a hint; runqpick() rechecks under the lock.
+  victim = 0;
+  for(v = cpus; v < &cpus[NCPU]; v++){
+    if(v != c && v->rq.n > 0 && (victim == 0 || v->rq.n > victim->rq.n))
+      victim = v;
+  }
+  if(victim == 0)
+    return 0;
+  acquire(&victim->rq.lock);
+  p = runqpick(&victim->rq);
+  release(&victim->rq.lock);
+  return p;
+}
+
+// The active CPU with the least work, for placing new processes.
+static int
+leastloaded(void)
+{
+  struct cpu *c, *best = &cpus[0];
+
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(c->active && c->rq.n + (c->proc != 0) < best->rq.n + (best->proc != 0))
+      best = c;
+  }
+  return best - cpus;
+}
+
+// Change p's state, charging the time spent in the old state
+// to p's statistics. Caller must hold p->lock.
+static void
+setstate(struct proc *p, enum procstate state)
+{
+  uint64 now = r_time();
+
+  switch(p->state){
+  case RUNNING:
+    p->runtime += now - p->statetime;
+    break;
+  case RUNNABLE:
+    p->waittime += now - p->statetime;
+    break;
+  case SLEEPING:
+    p->sleeptime += now - p->statetime;
+    break;
+  default:
+    break;
+  }
+  p->statetime = now;
+  p->state = state;
+}
+
+// Mark p RUNNABLE and put it on the run queue of the
+// CPU it last ran on, waking that CPU if it is idle.
+// Caller must hold p->lock.
+static void
+setrunnable(struct proc *p)
+{
+  setstate(p, RUNNABLE);
+  if(runqadd(p, &cpus[p->cpu].rq) && p->cpu != cpuid())
+    cpuwake(p->cpu);
 }
 
 
@@ -261,25 +619,34 @@ userinit(void)
   
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  setrunnable(p);
 
   release(&p->lock);
 }
 
 // Shrink user memory by n bytes.
+// If mega, back new memory with 2 MiB megapages where possible.
 // Return 0 on success, -1 on failure.
 int
-growproc(int n)
+growproc(int n, int mega)
 {
   uint64 sz;
   struct proc *p = myproc();
 
   sz = p->sz;
-  if(n > 0){
+  if(n > 0 && mega){
+    if((sz = uvmallocmega(p->pagetable, sz, sz + n, PTE_W)) == 0) {
+      return -1;
+    }
+  } else if(n > 0){
     if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
       return -1;
     }
   } else if(n < 0){
+    // cutting a megapage needs a page-table page; fail the
+    // shrink, not uvmunmap(), if there is none.
+    if(uvmsplit(p->pagetable, PGROUNDUP(sz + n)) != 0)
+      return -1;
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
   p->sz = sz;
@@ -295,6 +662,10 @@ kfork(void)
   struct proc *np;
   struct proc *p = myproc();
 
+  // Shared mmap() pages must exist before the child can share them.
+  if(vmafill(p) < 0)
+    return -1;
+
   // Allocate process.
   if((np = allocproc()) == 0){
     return -1;
@@ -307,6 +678,11 @@ kfork(void)
     return -1;
   }
   np->sz = p->sz;
+  if(vmadup(np, p) < 0){
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -331,9 +707,10 @@ kfork(void)
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
   np->nice = p->nice;
   initqueuelevel(np);
+  np->cpu = leastloaded();
+  setrunnable(np);
   release(&np->lock);
 
   return pid;
@@ -378,6 +755,7 @@ kexit(int status)
   iput(p->cwd);
   end_op();
   p->cwd = 0;
+  vmadrop(p->pagetable, p->vma);
 
   acquire(&wait_lock);
 
@@ -390,7 +768,7 @@ kexit(int status)
   acquire(&p->lock);
 
   p->xstate = status;
-  p->state = ZOMBIE;
+  setstate(p, ZOMBIE);
 
   release(&wait_lock);
 
@@ -405,7 +783,7 @@ int
 kwait(uint64 addr)
 {
   struct proc *pp;
-  int havekids, pid;
+  int havekids, pid, xstate;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
@@ -422,15 +800,15 @@ kwait(uint64 addr)
         if(pp->state == ZOMBIE){
           // Found one.
           pid = pp->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
-                                  sizeof(pp->xstate)) < 0) {
-            release(&pp->lock);
-            release(&wait_lock);
-            return -1;
-          }
+          xstate = pp->xstate;
           freeproc(pp);
           release(&pp->lock);
           release(&wait_lock);
+          // copyout() without spinlocks held, in case it must
+          // read a page in from a file.
+          if(addr != 0 && copyout(p->pagetable, addr, (char *)&xstate,
+                                  sizeof(xstate)) < 0)
+            return -1;
           return pid;
         }
         release(&pp->lock);
@@ -490,7 +868,7 @@ sys_nice(void) {
 
       // Log changes if necessary, release lock, and return nice val
       if (LOGGING_ENABLED) {
-        printf("nice set to %d for %d\n", p->nice, p->pid);
+        trace(TRACE_NICE, p->pid, p->nice);
       }
       release(&p->lock);
       return nice_val;
@@ -503,6 +881,164 @@ sys_nice(void) {
   // Failure, process not found
   return -1;
 }
+// Switch from the scheduler on CPU c to p, which was just taken
+// off a run queue, and return once p gives up the CPU.
+static void
+runproc(struct cpu *c, struct proc *p)
+{
+  acquire(&p->lock);
+  if(p->state == RUNNABLE) {
+    // Switch to chosen process.  It is the process's job
+    // to release its lock and then reacquire it
+    // before jumping back to us.
+
+    // Log scheduling changes if necessary
+    if (LOGGING_ENABLED) {
+      trace(TRACE_RUN, p->pid, 0);
+    }
+    if(p->cpu != c - cpus) {
+      // Migrating: keep p's CFS lag relative to the new queue.
+      p->vruntime = p->vruntime - cpus[p->cpu].rq.min_vruntime + c->rq.min_vruntime;
+    }
+    setstate(p, RUNNING);
+    p->cpu = c - cpus;
+    p->runstart = r_time();
+    c->proc = p;
+    swtch(&c->context, &p->context);
+
+    // Process is done running for now.
+    // It should have changed its p->state before coming back.
+    c->proc = 0;
+  }
+  release(&p->lock);
+}
+
+// If the process at the head of Q0 on c's run queue, the one that
+// has waited longest there, has waited more than starve cycles, move
+// it to the top queue; it is demoted from there as usual.
+// Returns 1 if it was starving.
+static int
+mlfqlift(struct cpu *c, uint64 starve)
+{
+  struct proc *p;
+  struct runq *rq;
+  int lifted = 0;
+
+  acquire(&c->rq.lock);
+  p = c->rq.head[2 - 0];    // run queue level of Q0
+  if(p != 0 && r_time() - p->statetime <= starve)
+    p = 0;
+  release(&c->rq.lock);
+  if(p == 0)
+    return 0;
+
+  // p may have run since; look again under its lock.
+  acquire(&p->lock);
+  if(p->state == RUNNABLE && p->queue_level == 0 &&
+     r_time() - p->statetime > starve){
+    rq = p->rq;
+    if(runqdel(p)){
+      p->queue_level = NMLFQ - 1;
+      p->runtime_in_queue = 0;
+      runqadd(p, rq);
+      lifted = 1;
+    }
+  }
+  release(&p->lock);
+  return lifted;
+}
+
+// MLFQ priority boost: every mlfq.boost ticks, move all processes
+// back to the starting queue for their nice value.
+// In adaptive mode each boost also lifts a process that has waited
+// in Q0 for more than mlfq.starve ticks (see mlfqlift()), which a
+// nice value above 10 would otherwise keep there, and halves the
+// period; a period with no starvation and no wakeups from sleep
+// (pure batch load) doubles it.
+static void
+mlfqboost(void)
+{
+  struct proc *p;
+  struct cpu *c;
+  int boost, adaptive, woke, starving = 0;
+  uint64 starve;
+
+  acquire(&tickslock);
+  boost = ticks - last_boost_time >= mlfq.boost;
+  // Reset last boost time; only one CPU performs each boost
+  if (boost)
+    last_boost_time = ticks;
+  adaptive = mlfq.adaptive;
+  starve = (uint64)mlfq.starve * TICKCYCLES;
+  release(&tickslock);
+
+  if (!boost)
+    return;
+
+  // Nothing to do unless someone was demoted since the last boost
+  if (__atomic_exchange_n(&mlfq_demoted, 0, __ATOMIC_SEQ_CST) != 0) {
+    for(p = proc; p < &proc[NPROC]; p++) {
+      // Ensure that each process is in the proper queue
+      // initqueuelevel() also moves queued processes to their new level
+      acquire(&p->lock);
+      initqueuelevel(p);
+      release(&p->lock);
+    }
+  }
+
+  if (adaptive) {
+    for(c = cpus; c < &cpus[NCPU]; c++)
+      starving += mlfqlift(c, starve);
+    woke = __atomic_exchange_n(&mlfq_wakeups, 0, __ATOMIC_SEQ_CST);
+    acquire(&tickslock);
+    if (starving) {
+      mlfq.boost = MAX(mlfq.boost / 2, MINBOOST);
+    } else if (woke == 0) {
+      mlfq.boost = MIN(mlfq.boost * 2, MAXBOOST);
+    }
+    release(&tickslock);
+  }
+}
+
+// Implementation of system call to read or change the MLFQ tunables
+// mlfqtune(params, set): if set is non-zero, validate and install
+// *params; then copy the tunables in effect back to *params.
+uint64
+sys_mlfqtune(void) {
+  uint64 addr;
+  int set;
+  struct mlfqparams mp;
+  struct proc *p = myproc();
+
+  argaddr(0, &addr);
+  argint(1, &set);
+
+  if (set) {
+    if (copyin(p->pagetable, (char *)&mp, addr, sizeof(mp)) < 0) {
+      return -1;
+    }
+    for (int i = 0; i < NMLFQ; i++) {
+      if (mp.quantum[i] < 1) {
+        return -1;
+      }
+    }
+    if (mp.boost < 1 || mp.starve < 1) {
+      return -1;
+    }
+    acquire(&tickslock);
+    mlfq = mp;
+    release(&tickslock);
+  }
+
+  acquire(&tickslock);
+  mp = mlfq;
+  release(&tickslock);
+  if (copyout(p->pagetable, addr, (char *)&mp, sizeof(mp)) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
@@ -510,13 +1046,19 @@ sys_nice(void) {
 //  - swtch to start running that process.
 //  - eventually that process transfers control
 //    via swtch back to the scheduler.
+// The policy (RR, RRSP, MLFQ or CFS) only decides which run queue
+// level a process waits at (see runqlevel()), when MLFQ demotes
+// (see yield()) and whether the MLFQ boost runs, so it can be
+// changed at any time with setscheduler().
 void
 scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int idle;
 
   c->proc = 0;
+  c->active = 1;
   for(;;){
     // The most recent process to run may have had interrupts
     // turned off; enable them to avoid a deadlock if all
@@ -526,175 +1068,79 @@ scheduler(void)
     intr_on();
     intr_off();
 
-    int found = 0;
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        
-        // Log scheduling changes if necessary
-        if (LOGGING_ENABLED) {
-          printf("running %d at %d\n", p->pid, ticks);
-        }
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-        found = 1;
-      }
-      release(&p->lock);
+    if (sched_policy == SCHED_MLFQ) {
+      mlfqboost();
     }
-    if(found == 0) {
-      // nothing to run; stop running on this core until an interrupt.
+
+    p = runqpop(c);
+    if(p == 0) {
+      // nothing to run; zero a free page for kzalloc(), then look
+      // for work again. once enough pages are zeroed,
+      // stop running on this core until an interrupt.
+      // don't ask for clock ticks while idle, only for the next timer
+      // event; restart the ticks once there may be work again.
+      // rq.idle tells setrunnable() to wake this core with cpuwake();
+      // it is set under rq.lock only if nothing was queued meanwhile.
+      if(kzerofill())
+        continue;
+      acquire(&c->rq.lock);
+      idle = c->rq.idle = (c->rq.n == 0);
+      release(&c->rq.lock);
+      if(!idle)
+        continue;
+      clockarm(1);
       asm volatile("wfi");
+      acquire(&c->rq.lock);
+      c->rq.idle = 0;
+      release(&c->rq.lock);
+      c->nexttick = r_time() + TICKCYCLES;
+      clockarm(0);
+      continue;
     }
+    runproc(c, p);
   }
 }
 
-// Round Robin Scheduler with Strict Priority
-// Take turns running but use strict nice level priority rules
-void
-scheduler_rrsp(void)
-{
-  // Same setup as usual
- struct proc *p;
- struct cpu *c = mycpu();
- c->proc = 0;
- for(;;){
-   intr_on();
-   intr_off();
-
-   // Since priority is calculated as 20 - nice, the minimum value is 0.
-   // -1 becomes a good starting value so we can tell if we did not find a process
-   int priority = -1;
-   for(p = proc; p < &proc[NPROC]; p++) {
-    // Check if a process is runnable, then calculate its priority level
-    // We will run all processes that have equal to the greatest priority level of the array
-     acquire(&p->lock);
-     if (p->state == RUNNABLE) {
-       int current_priority = 20 - p->nice;
-       if (current_priority > priority) {
-         priority = current_priority;
-       }
-     }
-     release(&p->lock);
-   }
-   // No process runnable
-   if (priority == -1) {
-     asm volatile("wfi");
-     continue;
-   }
-
-   // Now that we have computed the highest priority level, run processes that exist at that level
-   int found = 0;
-   for(p = proc; p < &proc[NPROC]; p++) {
-     acquire(&p->lock);
-
-     int current_priority = 20 - p->nice;
-
-     // As long as it is runnable and has correct priority, it can run
-     // We can use a strict == over a >= because we already know it is the maximum value
-     // because of the previous for loop, so it must match.
-     if(p->state == RUNNABLE && current_priority == priority) {
-
-      // Same logging and switching logic as all schedulers
-       if (LOGGING_ENABLED) {
-         printf("running %d at %d\n", p->pid, ticks);
-       }
-       p->state = RUNNING;
-       c->proc = p;
-       swtch(&c->context, &p->context);
-
-       c->proc = 0;
-       found = 1;
-     }
-     release(&p->lock);
-   }
-
-   if(found == 0) {
-     asm volatile("wfi");
-   }
- }
-}
-
-// Multi Level Feedback Queue Scheduler
-void
-scheduler_mlfq(void)
-{
+// Implementation of system call to change the scheduling policy
+// Returns the previous policy, or -1 if the policy is unknown.
+// A negative policy just returns the current one.
+uint64
+sys_setscheduler(void) {
+  int policy;
+  int old;
   struct proc *p;
-  struct cpu *c = mycpu();
-  c->proc = 0;
-  // Same continuous for loop
-  for(;;){
-     // Enable interrupts on this core.
-     intr_on();
-     intr_off();
-     // Acquire a lock to perform ticks calculations
-     acquire(&tickslock);
-     uint current_ticks = ticks;
-     uint64 last_boost = last_boost_time;
-     release(&tickslock);
-
-     if (current_ticks - last_boost >= 60) {
-      for(p = proc; p < &proc[NPROC]; p++) {
-        // Ensure that each process is in the proper queue
-        acquire(&p->lock);
-        initqueuelevel(p);
-        release(&p->lock);
-      }
-      // Reset last boost time
-      acquire(&tickslock);
-      last_boost_time = current_ticks;
-      release(&tickslock);
-     }
-     
-     
-     int found = 0;
-     int level = 2;
-     // While loop to represent the level we are on
-     // Start at top level and check the process array for a top level queue process
-     // Only move on to the next level once we have checked for the current level priority queue
-     while (level > -1) {
-      for(p = proc; p < &proc[NPROC]; p++) {
-        acquire(&p->lock);
-        if (p->queue_level == level && p->state == RUNNABLE) {
-
-        // Same logging and switching logic as all schedulers
-
-          if (LOGGING_ENABLED) {
-            printf("running %d at %d\n", p->pid, ticks);
-          }
-           p->state = RUNNING;
-           c->proc = p;
-
-           swtch(&c->context, &p->context);
-
-           c->proc = 0;
-           found = 1;
-        }
-        release(&p->lock);
-      }
-      // If we made it through the whole array and do not have a process to run,
-      // decrement the level and check the next priority queue
-      level --;
-      if (found == 1) {
-        level = 2;
-        found = 0;
-      }
+
+  argint(0, &policy);
+  old = sched_policy;
+  if (policy < 0) {
+    return old;
+  }
+  if (policy != SCHED_RR && policy != SCHED_RRSP && policy != SCHED_MLFQ &&
+      policy != SCHED_CFS) {
+    return -1;
+  }
+
+  sched_policy = policy;
+
+  // Re-queue every waiting process at its level under the new policy.
+  // Processes that are running or sleeping pick up the new level the
+  // next time they become runnable.
+  for(p = proc; p < &proc[NPROC]; p++) {
+    acquire(&p->lock);
+    if (policy == SCHED_MLFQ) {
+      // Start MLFQ from a clean slate, like a priority boost;
+      // this also re-queues p if it is waiting
+      initqueuelevel(p);
+    } else if (runqdel(p)) {
+      setrunnable(p);
     }
-    // If we have ended the while loop then there are NO processes to run across ALL levels
-    // So we can just wait until there is a process
-      if(found == 0) {
-        // nothing to run; stop running on this core until an interrupt.
-        asm volatile("wfi");
-      }
-     
-   }
+    release(&p->lock);
+  }
+
+  if (LOGGING_ENABLED) {
+    trace(TRACE_SCHED, 0, policy);
+  }
+  return old;
 }
 
 // Switch to scheduler.  Must hold only p->lock
@@ -729,21 +1175,41 @@ void
 yield(void)
 {
   struct proc *p = myproc();
+  int quantum[NMLFQ];
+
+  // Snapshot the quanta, which sys_mlfqtune() changes under
+  // tickslock.
+  if (sched_policy == SCHED_MLFQ) {
+    acquire(&tickslock);
+    memmove(quantum, mlfq.quantum, sizeof(quantum));
+    release(&tickslock);
+  }
 
   acquire(&p->lock);
 
-  #if SCHEDULER == SCHED_MLFQ
+  if (sched_policy == SCHED_MLFQ) {
     p->runtime_in_queue ++;
-    if(p->queue_level == 2 && p->runtime_in_queue >= 1) {
-      p->queue_level = 1; // Demote to Q1
+    // Demote to the next queue once the quantum at this level is used up
+    if(p->queue_level > 0 && p->runtime_in_queue >= quantum[p->queue_level]) {
+      p->queue_level--;
       p->runtime_in_queue = 0;
-    } else if(p->queue_level == 1 && p->runtime_in_queue >= 10) {
-      p->queue_level = 0; // Demote to Q0
+      p->ndemote++;
+      __sync_fetch_and_add(&mlfq_demoted, 1);
+    } else if(p->queue_level == 0) {
+      // Q0 cannot demote, so its quantum is a time slice: keep the
+      // CPU until it is used up, unless Q2 or Q1 (run queue levels
+      // 0 and 1) has a process waiting here.
+      if(p->runtime_in_queue < quantum[0] && (mycpu()->rq.mask & 3) == 0) {
+        release(&p->lock);
+        return;
+      }
       p->runtime_in_queue = 0;
     }
-  #endif
+  }
     
-  p->state = RUNNABLE;
+  p->nivcsw++;
+  accountrun(p);
+  setrunnable(p);
   sched();
   release(&p->lock);
 }
@@ -803,8 +1269,10 @@ sleep(void *chan, struct spinlock *lk)
   release(lk);
 
   // Go to sleep.
+  accountrun(p);
   p->chan = chan;
-  p->state = SLEEPING;
+  p->nvcsw++;
+  setstate(p, SLEEPING);
 
   sched();
 
@@ -827,7 +1295,8 @@ wakeup(void *chan)
     if(p != myproc()){
       acquire(&p->lock);
       if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
+        setrunnable(p);
+        __atomic_add_fetch(&mlfq_wakeups, 1, __ATOMIC_RELAXED);
       }
       release(&p->lock);
     }
@@ -848,7 +1317,7 @@ kkill(int pid)
       p->killed = 1;
       if(p->state == SLEEPING){
         // Wake process from sleep().
-        p->state = RUNNABLE;
+        setrunnable(p);
       }
       release(&p->lock);
       return 0;
@@ -907,6 +1376,69 @@ either_copyin(void *dst, int user_src, uint64 src, uint64 len)
   }
 }
 
+// Fill in *ps from p, charging the current state's time so far.
+// Caller must hold p->lock.
+static void
+getstats(struct proc *p, struct procstats *ps)
+{
+  uint64 now = r_time();
+
+  ps->pid = p->pid;
+  ps->state = p->state;
+  ps->nice = p->nice;
+  ps->queue_level = p->queue_level;
+  ps->runtime = p->runtime;
+  ps->waittime = p->waittime;
+  ps->sleeptime = p->sleeptime;
+  if(p->state == RUNNING)
+    ps->runtime += now - p->statetime;
+  else if(p->state == RUNNABLE)
+    ps->waittime += now - p->statetime;
+  else if(p->state == SLEEPING)
+    ps->sleeptime += now - p->statetime;
+  ps->nvcsw = p->nvcsw;
+  ps->nivcsw = p->nivcsw;
+  ps->ndemote = p->ndemote;
+  safestrcpy(ps->name, p->name, sizeof(ps->name));
+}
+
+// Implementation of system call to read scheduling statistics
+// getprocstats(pid, buf) copies the statistics of process pid to buf.
+// getprocstats(0, buf) copies those of every process to buf, which
+// must hold NPROC entries, and returns how many it copied.
+// Returns -1 if the process is not found or buf is bad.
+uint64
+sys_getprocstats(void) {
+  int pid;
+  uint64 addr;
+  struct proc *p;
+  struct procstats ps;
+  int n = 0;
+
+  argint(0, &pid);
+  argaddr(1, &addr);
+
+  for(p = proc; p < &proc[NPROC]; p++) {
+    acquire(&p->lock);
+    if(p->state == UNUSED || (pid != 0 && p->pid != pid)) {
+      release(&p->lock);
+      continue;
+    }
+    getstats(p, &ps);
+    release(&p->lock);
+
+    // copyout() without p->lock held, in case it must fault in a page
+    if(copyout(myproc()->pagetable, addr + n * sizeof(ps), (char *)&ps, sizeof(ps)) < 0) {
+      return -1;
+    }
+    n++;
+    if(pid != 0) {
+      return 0;
+    }
+  }
+  return pid == 0 ? n : -1;
+}
+
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
 // No lock to avoid wedging a stuck machine further.
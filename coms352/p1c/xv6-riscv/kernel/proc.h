@@ -18,12 +18,40 @@ struct context {
   uint64 s11;
 };
 
+// Run queue of RUNNABLE processes. Every CPU has one; a runnable
+// process waits on the queue of the CPU it last ran on, linked
+// through p->rq_next/p->rq_prev, so that picking the next process
+// does not require a scan of proc[]. There is one FIFO per priority
+// level, level 0 being the highest, and bit i of mask is set when
+// level i is non-empty, so the next process is the head of the
+// level given by the lowest set bit. RRSP uses one level per nice
+// value, MLFQ one per queue level, and RR only level 0.
+// CFS instead keeps its processes in a min-heap ordered by
+// virtual runtime.
+#define NRUNQ 40
+#define RQ_HEAP (-1)          // rq_level of a process in the CFS heap
+
+struct runq {
+  struct spinlock lock;
+  int n;                      // Number of queued processes
+  uint64 mask;                // Bit i set if level i is non-empty
+  struct proc *head[NRUNQ];
+  struct proc *tail[NRUNQ];
+  struct proc *heap[NPROC];   // CFS: min-heap on p->vruntime
+  int nheap;                  // CFS: number of processes in heap
+  uint64 min_vruntime;        // CFS: vruntime of the last pick
+  int idle;                   // Its CPU is asleep in wfi, queue empty
+};
+
 // Per-CPU state.
 struct cpu {
   struct proc *proc;          // The process running on this cpu, or null.
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  int active;                 // Has this CPU entered its scheduler?
+  uint64 nexttick;            // r_time() of this CPU's next scheduling tick
+  struct runq rq;             // Processes waiting to run on this CPU
 };
 
 extern struct cpu cpus[NCPU];
@@ -81,6 +109,29 @@ struct trapframe {
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// A region of user memory whose pages are read from a file, or
+// zero-filled, on first touch (see vma.c): a segment of the
+// program, below p->sz, or an mmap() region, above the heap.
+// end is 0 if the slot is unused.
+struct vma {
+  uint64 start;                // first address, page-aligned
+  uint64 end;                  // one past the last address
+  int perm;                    // PTE_R, PTE_W, PTE_X bits
+  int flags;                   // MAP_SHARED or MAP_PRIVATE
+  struct inode *ip;            // backing file, or 0 for zero-filled memory
+  uint off;                    // file offset of start
+  uint filesz;                 // bytes from the file; zero-filled after
+};
+
+// The copy functions' cached translation (see utlbwalk() in vm.c):
+// the last-level page table of pagetable that maps the 2 MiB
+// starting at base. pagetable is 0 if nothing is cached.
+struct utlb {
+  pagetable_t pagetable;
+  uint64 base;
+  pte_t *pt;
+};
+
 // Per-process state
 struct proc {
   struct spinlock lock;
@@ -103,8 +154,32 @@ struct proc {
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  struct vma vma[NVMA];        // File-backed memory regions
+  struct utlb utlb;            // copyin()/copyout() translation cache
+  struct inode *iolock;        // Inode fileread()/filewrite() hold locked
+  uint64 iofault;              // Page vmafault() left them to fault in
   char name[16];               // Process name (debugging)
   int nice;                    // Nice Value (Scheduling Priority)
   int queue_level;             // MLFQ Queue level - 2 (highest), 1, 0 (lowest)
   int runtime_in_queue;        // Runtime at the current queue level (in ticks)
+
+  int cpu;                     // CPU whose run queue p waits on
+  uint64 runstart;             // r_time() when p was last dispatched
+  uint64 vruntime;             // CFS: weighted run time (cycles at nice 0)
+
+  // Scheduling statistics (see getprocstats()); p->lock must be held.
+  uint64 statetime;            // r_time() of the last state change
+  uint64 runtime;              // Total time RUNNING
+  uint64 waittime;             // Total time RUNNABLE
+  uint64 sleeptime;            // Total time SLEEPING
+  int nvcsw;                   // Voluntary context switches
+  int nivcsw;                  // Involuntary context switches
+  int ndemote;                 // MLFQ demotions
+
+  // p->rq->lock must be held when using these:
+  struct runq *rq;             // Run queue p is linked on, or 0
+  int rq_level;                // Level of rq that p is linked on, or RQ_HEAP
+  int heapidx;                 // Index in rq->heap if rq_level == RQ_HEAP
+  struct proc *rq_next;        // Next process on the same run queue
+  struct proc *rq_prev;        // Previous process on the same run queue
 };
@@ -0,0 +1,16 @@
+// Per-process scheduling statistics, returned by getprocstats().
+// Times are in r_time() cycles (TIMEFREQ per second).
+
+struct procstats {
+  int pid;
+  int state;            // enum procstate
+  int nice;
+  int queue_level;      // MLFQ queue level
+  uint64 runtime;       // time spent RUNNING
+  uint64 waittime;      // time spent RUNNABLE, waiting for a CPU
+  uint64 sleeptime;     // time spent SLEEPING
+  int nvcsw;            // voluntary context switches (sleep)
+  int nivcsw;           // involuntary context switches (preempted)
+  int ndemote;          // MLFQ demotions
+  char name[16];
+};
@@ -0,0 +1,208 @@
+// Slab allocator for fixed-size kernel objects
+// (struct file, struct pipe, struct inode, struct buf).
+//
+// A slab is a block of 2^order pages from kallocpages(), aligned
+// to its size, starting with a struct slab header followed by
+// objects. Since slabs are aligned, an object's slab is found by
+// rounding its address down. Each CPU keeps a magazine of free
+// objects per cache, so slaballoc() and slabfree() only take the
+// cache lock to refill or flush half a magazine.
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "slab.h"
+#include "memstat.h"
+
+struct obj {
+  struct obj *next;
+};
+
+struct slab {
+  struct slabcache *sc;
+  struct slab *next;     // on sc->partial
+  struct slab *prev;
+  struct obj *free;      // free objects in this slab
+  int inuse;
+};
+
+#define SLABHDR ((sizeof(struct slab) + 7) & ~7L)
+
+// every cache, for memstats()
+static struct slabcache *caches[NSLAB];
+static int ncaches;
+
+// Set up cache sc for objects of size bytes. Picks the
+// smallest slab that wastes no more than 1/8 of its space.
+void
+slabinit(struct slabcache *sc, char *name, uint size)
+{
+  uint bytes;
+  int waste;
+
+  initlock(&sc->lock, name);
+  sc->name = name;
+  sc->size = (size + 7) & ~7;
+  for(sc->order = 0; sc->order < NORDER - 1; sc->order++){
+    bytes = PGSIZE << sc->order;
+    sc->perslab = (bytes - SLABHDR) / sc->size;
+    waste = bytes - SLABHDR - sc->perslab * sc->size;
+    if(sc->perslab > 0 && waste * 8 <= bytes)
+      break;
+  }
+  if(sc->perslab == 0)
+    panic("slabinit: size");
+  if(ncaches == NSLAB)
+    panic("slabinit: too many caches");
+  caches[ncaches++] = sc;
+}
+
+static void
+slabunlink(struct slabcache *sc, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    sc->partial = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+  sc->npartial--;
+}
+
+static void
+slabpush(struct slabcache *sc, struct slab *s)
+{
+  s->prev = 0;
+  s->next = sc->partial;
+  if(s->next)
+    s->next->prev = s;
+  sc->partial = s;
+  sc->npartial++;
+}
+
+// Take an object from a slab, allocating a new slab if
+// none has a free object. Caller holds sc->lock.
+static void *
+slabget(struct slabcache *sc)
+{
+  struct slab *s;
+  struct obj *o;
+  char *p;
+
+  if((s = sc->partial) == 0){
+    if((s = kallocpages(sc->order)) == 0)
+      return 0;
+    s->sc = sc;
+    s->free = 0;
+    s->inuse = 0;
+    p = (char*)s + SLABHDR;
+    for(int i = 0; i < sc->perslab; i++, p += sc->size){
+      o = (struct obj*)p;
+      o->next = s->free;
+      s->free = o;
+    }
+    slabpush(sc, s);
+    sc->nslab++;
+  }
+
+  o = s->free;
+  s->free = o->next;
+  if(++s->inuse == sc->perslab)
+    slabunlink(sc, s);
+  sc->ninuse++;
+  return o;
+}
+
+// Return an object to its slab. Frees the slab once it is
+// empty, unless it is the only one with free objects.
+// Caller holds sc->lock.
+static void
+slabput(struct slabcache *sc, void *obj)
+{
+  struct slab *s = (struct slab*)((uint64)obj & ~((PGSIZE << sc->order) - 1));
+  struct obj *o = obj;
+
+  if(s->sc != sc)
+    panic("slabput");
+  if(s->inuse-- == sc->perslab)
+    slabpush(sc, s);
+  o->next = s->free;
+  s->free = o;
+  sc->ninuse--;
+  if(s->inuse == 0 && sc->npartial > 1){
+    slabunlink(sc, s);
+    sc->nslab--;
+    kfreepages(s, sc->order);
+  }
+}
+
+// Allocate an object from cache sc.
+// Returns 0 if out of memory.
+void *
+slaballoc(struct slabcache *sc)
+{
+  struct magazine *m;
+  void *obj = 0;
+
+  push_off();
+  m = &sc->mag[cpuid()];
+  if(m->n == 0){
+    acquire(&sc->lock);
+    while(m->n < MAGSIZE / 2 && (obj = slabget(sc)) != 0)
+      m->obj[m->n++] = obj;
+    release(&sc->lock);
+  }
+  if(m->n > 0)
+    obj = m->obj[--m->n];
+  pop_off();
+  return obj;
+}
+
+// Free an object that came from slaballoc(sc).
+void
+slabfree(struct slabcache *sc, void *obj)
+{
+  struct magazine *m;
+
+#if KDEBUG
+  // Fill with junk to catch dangling refs.
+  memset(obj, 1, sc->size);
+#endif
+
+  push_off();
+  m = &sc->mag[cpuid()];
+  if(m->n == MAGSIZE){
+    acquire(&sc->lock);
+    while(m->n > MAGSIZE / 2)
+      slabput(sc, m->obj[--m->n]);
+    release(&sc->lock);
+  }
+  m->obj[m->n++] = obj;
+  pop_off();
+}
+
+// Fill in the slab statistics for memstats().
+void
+slabstats(struct memstats *st)
+{
+  struct slabcache *sc;
+  int i, c;
+
+  for(i = 0; i < ncaches; i++){
+    sc = caches[i];
+    safestrcpy(st->slab[i].name, sc->name, sizeof(st->slab[i].name));
+    acquire(&sc->lock);
+    st->slab[i].size = sc->size;
+    st->slab[i].perslab = sc->perslab;
+    st->slab[i].pages = sc->nslab << sc->order;
+    st->slab[i].inuse = sc->ninuse;
+    release(&sc->lock);
+    // magazines hold free objects too; the counts are
+    // read without a lock, so they are only a snapshot.
+    for(c = 0; c < NCPU; c++)
+      st->slab[i].inuse -= sc->mag[c].n;
+  }
+  st->nslab = ncaches;
+}
@@ -0,0 +1,23 @@
+// Object caches for fixed-size kernel objects.
+
+#define MAGSIZE 8   // objects a CPU's magazine holds
+
+// A CPU's stack of free objects, used without a lock
+// while interrupts are off.
+struct magazine {
+  int n;
+  void *obj[MAGSIZE];
+};
+
+struct slabcache {
+  struct spinlock lock;  // protects everything but mag
+  char *name;
+  uint size;             // object size, rounded up to 8 bytes
+  int order;             // each slab is 2^order pages
+  int perslab;           // objects per slab
+  struct slab *partial;  // slabs with free objects
+  int npartial;
+  uint64 nslab;          // slabs allocated
+  uint64 ninuse;         // objects out of the slabs, incl. magazines
+  struct magazine mag[NCPU];
+};
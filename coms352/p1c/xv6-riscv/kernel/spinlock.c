@@ -7,13 +7,38 @@
 #include "riscv.h"
 #include "proc.h"
 #include "defs.h"
+#include "lockstat.h"
+
+extern char end[]; // first address after kernel.
+
+// The locks in the kernel's own data, for lockstats(). Locks
+// in memory from kalloc() or a slab cache are left out, since
+// the memory may be freed and reused.
+static struct {
+  struct spinlock *lk[NLOCKSTAT];
+  int n;
+} stats;
 
 void
 initlock(struct spinlock *lk, char *name)
 {
+  int i;
+
   lk->name = name;
   lk->locked = 0;
   lk->cpu = 0;
+  lk->nacquire = 0;
+  lk->ncontend = 0;
+  lk->nspin = 0;
+
+  if((uint64)lk < KERNBASE || (char*)lk >= end)
+    return;
+  for(i = 0; i < __atomic_load_n(&stats.n, __ATOMIC_ACQUIRE) && i < NLOCKSTAT; i++)
+    if(stats.lk[i] == lk)
+      return;
+  i = __atomic_fetch_add(&stats.n, 1, __ATOMIC_RELAXED);
+  if(i < NLOCKSTAT)
+    stats.lk[i] = lk;
 }
 
 // Acquire the lock.
@@ -29,8 +54,9 @@ acquire(struct spinlock *lk)
   //   a5 = 1
   //   s1 = &lk->locked
   //   amoswap.w.aq a5, a5, (s1)
+  uint64 spins = 0;
   while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+    spins++;
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,6 +66,11 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for holding() and debugging.
   lk->cpu = mycpu();
+  lk->nacquire++;
+  if(spins){
+    lk->ncontend++;
+    lk->nspin += spins;
+  }
 }
 
 // Release the lock.
@@ -81,6 +112,45 @@ holding(struct spinlock *lk)
   return r;
 }
 
+// Copy statistics for up to n lock names to user address dst,
+// summing over the locks that share a name. The counters are
+// read without the locks, so they may be a little out of date.
+// Returns the number of entries copied, or -1 on error.
+int
+lockstats(uint64 dst, int n)
+{
+  struct lockstat st;
+  struct spinlock *lk;
+  int i, j, nlk, copied = 0;
+
+  nlk = __atomic_load_n(&stats.n, __ATOMIC_ACQUIRE);
+  if(nlk > NLOCKSTAT)
+    nlk = NLOCKSTAT;
+  for(i = 0; i < nlk && copied < n; i++){
+    // reported with an earlier lock of the same name?
+    for(j = 0; j < i; j++)
+      if(strncmp(stats.lk[j]->name, stats.lk[i]->name, sizeof(st.name)) == 0)
+        break;
+    if(j < i)
+      continue;
+    memset(&st, 0, sizeof(st));
+    safestrcpy(st.name, stats.lk[i]->name, sizeof(st.name));
+    for(j = i; j < nlk; j++){
+      lk = stats.lk[j];
+      if(strncmp(lk->name, st.name, sizeof(st.name)) != 0)
+        continue;
+      st.nlocks++;
+      st.nacquire += lk->nacquire;
+      st.ncontend += lk->ncontend;
+      st.nspin += lk->nspin;
+    }
+    if(copyout(myproc()->pagetable, dst + copied * sizeof(st), (char*)&st, sizeof(st)) < 0)
+      return -1;
+    copied++;
+  }
+  return copied;
+}
+
 // push_off/pop_off are like intr_off()/intr_on() except that they are matched:
 // it takes two pop_off()s to undo two push_off()s.  Also, if interrupts
 // are initially off, then push_off, pop_off leaves them off.
@@ -5,5 +5,10 @@ struct spinlock {
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+
+  // For lockstats(), updated while holding the lock:
+  uint64 nacquire;   // acquire() calls
+  uint64 ncontend;   // acquire() calls that had to spin
+  uint64 nspin;      // times around the spin loop
 };
 
@@ -6,6 +6,7 @@
 
 void main();
 void timerinit();
+void machinevec();
 
 // entry.S needs one stack per CPU.
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
@@ -30,7 +31,7 @@ start()
   // delegate all interrupts and exceptions to supervisor mode.
   w_medeleg(0xffff);
   w_mideleg(0xffff);
-  w_sie(r_sie() | SIE_SEIE | SIE_STIE);
+  w_sie(r_sie() | SIE_SEIE | SIE_STIE | SIE_SSIE);
 
   // configure Physical Memory Protection to give supervisor mode
   // access to all of physical memory.
@@ -44,6 +45,14 @@ start()
   int id = r_mhartid();
   w_tp(id);
 
+  // machine software interrupts, which one CPU raises on another
+  // through the CLINT to wake it (see cpuwake()), can't be
+  // delegated; machinevec passes them on as supervisor software
+  // interrupts. it finds this hart's MSIP register in mscratch.
+  w_mscratch(CLINT_MSIP(id));
+  w_mtvec((uint64)machinevec);
+  w_mie(r_mie() | MIE_MSIE);
+
   // switch to supervisor mode and jump to main().
   asm volatile("mret");
 }
@@ -62,5 +71,5 @@ timerinit()
   w_mcounteren(r_mcounteren() | 2);
   
   // ask for the very first timer interrupt.
-  w_stimecmp(r_time() + 1000000);
+  w_stimecmp(r_time() + TICKCYCLES);
 }
@@ -0,0 +1,327 @@
+// Swap: paging user memory out to disk when physical memory runs short.
+//
+// The NSWAP pages of swap space are the disk blocks right after the
+// file system. When kallocuser() finds no free page, reclaim() runs
+// a clock (second chance) over the user pages of every process: a
+// page whose accessed bit (PTE_A) is set has it cleared and is
+// passed over, and a page not touched since the hand last came by
+// is written to a swap slot. Its PTE becomes a swap entry: PTE_V
+// clear, PTE_SWAP set, the slot number where the PPN was, and the
+// page's other flags kept. vmfault() reads the page back with
+// swapin() when the process touches it again. Clean read-only
+// pages of the program are dropped instead of written; vmfault()
+// reads them from the file again.
+//
+// Only pages with a single reference are paged out, so no shared
+// copy-on-write pages, shared text or megapages, and nothing from
+// MAP_SHARED mappings, which munmap() must write back. Nor are
+// pages taken from a process that is running on another CPU, whose
+// TLB may hold them: xv6 flushes the TLB whenever it switches page
+// tables, so a sleeping or runnable process has no TLB entries.
+// The copy functions in vm.c, uvmunmap() and uvmdup() look at and
+// use each PTE with interrupts off, so a process cannot be
+// preempted between finding a user page and copying, freeing or
+// sharing it.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "defs.h"
+#include "fs.h"
+#include "fcntl.h"
+#include "memstat.h"
+
+#define SWAPSTART  FSSIZE             // first disk block of swap
+#define SLOTBLOCKS (PGSIZE / BSIZE)   // disk blocks per slot
+#define SWAPBATCH  32                 // pages reclaim() tries to free
+#define SCANBATCH  64                 // PTEs looked at per p->lock
+
+extern struct proc proc[NPROC];
+
+static struct {
+  struct spinlock lock;
+  uchar ref[NSWAP];     // swap entries naming each slot
+  uchar busy[NSWAP];    // being written out
+  int next;             // where to look for a free slot
+  uint64 nin, nout, ndrop;
+} swap;
+
+// the clock hand: the next page reclaim() looks at is at or
+// after address va in process proc[hand.proc].
+static struct {
+  struct sleeplock lock;  // one reclaim() at a time
+  int proc;
+  uint64 va;
+} hand;
+
+void
+swapinit(void)
+{
+  initlock(&swap.lock, "swap");
+  initsleeplock(&hand.lock, "swaphand");
+}
+
+// Allocate a swap slot, marked busy, for a page about to be
+// written out. Returns the slot, or -1 if swap is full.
+static int
+slotalloc(void)
+{
+  int i, s;
+
+  acquire(&swap.lock);
+  for(i = 0; i < NSWAP; i++){
+    s = (swap.next + i) % NSWAP;
+    if(swap.ref[s] == 0 && swap.busy[s] == 0){
+      swap.ref[s] = 1;
+      swap.busy[s] = 1;
+      swap.next = (s + 1) % NSWAP;
+      release(&swap.lock);
+      return s;
+    }
+  }
+  release(&swap.lock);
+  return -1;
+}
+
+// Another swap entry names slot s; for fork().
+void
+swapdup(int s)
+{
+  acquire(&swap.lock);
+  swap.ref[s]++;
+  release(&swap.lock);
+}
+
+// Drop a swap entry naming slot s, freeing the slot with the last.
+// A slot still being written is not reused until the write is done.
+void
+swapput(int s)
+{
+  acquire(&swap.lock);
+  if(swap.ref[s] == 0)
+    panic("swapput");
+  swap.ref[s]--;
+  release(&swap.lock);
+}
+
+// Can reclaim() take pages from p? Caller holds p->lock.
+static int
+reclaimable(struct proc *p)
+{
+  if(p->pagetable == 0)
+    return 0;
+  if(p->state == SLEEPING || p->state == RUNNABLE)
+    return 1;
+  return p == myproc();
+}
+
+// The user addresses of p that reclaim() considers are [0, p->sz)
+// and the private mmap() regions above it. Return the first such
+// address at or after va, and set *end to the end of its range;
+// or return -1 if there is none.
+static uint64
+nextrange(struct proc *p, uint64 va, uint64 *end)
+{
+  struct vma *v, *best = 0;
+
+  if(va < p->sz){
+    *end = p->sz;
+    return va;
+  }
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->end == 0 || v->start < p->sz || (v->flags & MAP_SHARED))
+      continue;
+    if(v->end > va && (best == 0 || v->start < best->start))
+      best = v;
+  }
+  if(best == 0)
+    return -1;
+  *end = best->end;
+  return va > best->start ? va : best->start;
+}
+
+// Find the next page of p at or after *va that reclaim() could
+// take: a present 4 KiB user page with one reference. Looks at
+// no more than SCANBATCH PTEs. Returns its PTE and sets *va, or
+// returns 0 and sets *va to where to go on (-1 if p has no more
+// pages). Caller holds p->lock.
+static pte_t *
+nextpage(struct proc *p, uint64 *va)
+{
+  uint64 a, end;
+  pte_t *pte;
+  int level, n;
+
+  a = *va;
+  for(n = 0; n < SCANBATCH; n++){
+    if((a = nextrange(p, a, &end)) == -1)
+      break;
+    for(; a < end && n < SCANBATCH; n++){
+      pte = walklevel(p->pagetable, a, 0, 0, &level);
+      if(pte == 0 || level > 0){
+        // no page table here, or a megapage.
+        a = MEGAROUNDDOWN(a) + MEGASIZE;
+        continue;
+      }
+      if((*pte & (PTE_V|PTE_U)) == (PTE_V|PTE_U) &&
+         krefs((void*)PTE2PA(*pte)) == 1){
+        *va = a;
+        return pte;
+      }
+      a += PGSIZE;
+    }
+  }
+  *va = a;
+  return 0;
+}
+
+// Page out up to want user pages. May sleep; the caller must not
+// hold spin-locks. Returns the number of pages freed.
+static int
+reclaim(int want)
+{
+  struct proc *p;
+  struct vma *v;
+  pte_t *pte;
+  uint64 pa, va;
+  int freed = 0, laps = 0, slot;
+
+  acquiresleep(&hand.lock);
+  while(freed < want && laps < 3){
+    p = &proc[hand.proc];
+    acquire(&p->lock);
+    va = hand.va;
+    if(!reclaimable(p) || ((pte = nextpage(p, &va)) == 0 && va == -1)){
+      release(&p->lock);
+      hand.va = 0;
+      if(++hand.proc == NPROC){
+        hand.proc = 0;
+        laps++;   // three laps give every page its second chance
+      }
+      continue;
+    }
+    if(pte == 0){
+      release(&p->lock);
+      hand.va = va;
+      continue;
+    }
+    hand.va = va + PGSIZE;
+
+    if(*pte & PTE_A){
+      // used since the hand last came by: a second chance.
+      *pte &= ~PTE_A;
+      release(&p->lock);
+      continue;
+    }
+
+    pa = PTE2PA(*pte);
+    v = vmafind(p, va);
+    if(v && v->ip && (*pte & (PTE_W|PTE_COW)) == 0){
+      // an unmodified page of the file: read it again on demand.
+      *pte = 0;
+      release(&p->lock);
+      kfree((void*)pa);
+      __atomic_add_fetch(&swap.ndrop, 1, __ATOMIC_RELAXED);
+      freed++;
+      continue;
+    }
+
+    if((slot = slotalloc()) < 0){
+      release(&p->lock);
+      break;
+    }
+    *pte = ((uint64)slot << 10) | (PTE_FLAGS(*pte) & ~(PTE_V|PTE_A)) | PTE_SWAP;
+    release(&p->lock);
+
+    // the page is ours now; if the process faults on it, swapin()
+    // waits for the write to finish.
+    virtio_disk_rwpage(SWAPSTART + slot * SLOTBLOCKS, (void*)pa, 1);
+    acquire(&swap.lock);
+    swap.busy[slot] = 0;
+    swap.nout++;
+    wakeup(&swap.busy[slot]);
+    release(&swap.lock);
+    kfree((void*)pa);
+    freed++;
+  }
+  releasesleep(&hand.lock);
+  return freed;
+}
+
+// Allocate a page for user memory, zeroed if zero is set, freeing
+// buffer cache blocks or paging out other user pages if memory
+// is short. Reclaiming may sleep,
+// so it is only tried if the caller holds no spin-locks.
+// Returns 0 if no page could be had.
+void *
+kallocuser(int zero)
+{
+  void *pa;
+  int locked;
+
+  for(;;){
+    if((pa = zero ? kzalloc() : kalloc()) != 0)
+      return pa;
+    push_off();
+    locked = mycpu()->noff > 1;
+    pop_off();
+    if(locked)
+      return 0;
+    // cached disk blocks are cheaper to give up than user pages.
+    if(bshrink(SWAPBATCH * (PGSIZE / BSIZE)) == 0 && reclaim(SWAPBATCH) == 0)
+      return 0;
+  }
+}
+
+// Read the page at va, whose PTE is a swap entry, back into memory.
+// Returns its physical address, or 0 if out of memory.
+uint64
+swapin(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  char *mem;
+  uint64 flags;
+  int slot;
+
+  if((mem = kallocuser(0)) == 0)
+    return 0;
+  pte = walk(pagetable, va, 0);
+  if(pte == 0 || (*pte & PTE_SWAP) == 0)
+    panic("swapin");
+  slot = *pte >> 10;
+
+  acquire(&swap.lock);
+  while(swap.busy[slot])
+    sleep(&swap.busy[slot], &swap.lock);
+  release(&swap.lock);
+  virtio_disk_rwpage(SWAPSTART + slot * SLOTBLOCKS, mem, 0);
+
+  // the page is this process's own now, even if it was
+  // copy-on-write when it went out.
+  flags = PTE_FLAGS(*pte) & ~(PTE_SWAP|PTE_D);
+  if(flags & PTE_COW)
+    flags = (flags & ~PTE_COW) | PTE_W;
+  *pte = PA2PTE(mem) | flags | PTE_V;
+  swapput(slot);
+  __atomic_add_fetch(&swap.nin, 1, __ATOMIC_RELAXED);
+  return (uint64)mem;
+}
+
+// Fill in the swap statistics for memstats().
+void
+swapstats(struct memstats *st)
+{
+  acquire(&swap.lock);
+  st->swapsize = NSWAP;
+  for(int s = 0; s < NSWAP; s++)
+    if(swap.ref[s])
+      st->swapused++;
+  st->swapins = swap.nin;
+  st->swapouts = swap.nout;
+  st->swapdrops = swap.ndrop;
+  release(&swap.lock);
+}
@@ -105,6 +105,17 @@ extern uint64 sys_close(void);
 extern uint64 sys_startLogging(void);
 extern uint64 sys_stopLogging(void);
 extern uint64 sys_nice(void);
+extern uint64 sys_setscheduler(void);
+extern uint64 sys_readtrace(void);
+extern uint64 sys_usleep(void);
+extern uint64 sys_getprocstats(void);
+extern uint64 sys_mlfqtune(void);
+extern uint64 sys_memstats(void);
+extern uint64 sys_mmap(void);
+extern uint64 sys_munmap(void);
+extern uint64 sys_lockstats(void);
+extern uint64 sys_setreadahead(void);
+extern uint64 sys_dropcache(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -134,6 +145,17 @@ static uint64 (*syscalls[])(void) = {
 [SYS_startLogging] sys_startLogging,
 [SYS_stopLogging] sys_stopLogging,
 [SYS_nice] sys_nice,
+[SYS_setscheduler] sys_setscheduler,
+[SYS_readtrace] sys_readtrace,
+[SYS_usleep] sys_usleep,
+[SYS_getprocstats] sys_getprocstats,
+[SYS_mlfqtune] sys_mlfqtune,
+[SYS_memstats] sys_memstats,
+[SYS_mmap] sys_mmap,
+[SYS_munmap] sys_munmap,
+[SYS_lockstats] sys_lockstats,
+[SYS_setreadahead] sys_setreadahead,
+[SYS_dropcache] sys_dropcache,
 };
 
 void
@@ -143,6 +165,8 @@ syscall(void)
   struct proc *p = myproc();
 
   num = p->trapframe->a7;
+  // a page table the last call cached may be gone.
+  p->utlb.pagetable = 0;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
     // Use num to lookup the system call function for num, call it,
     // and store its return value in p->trapframe->a0
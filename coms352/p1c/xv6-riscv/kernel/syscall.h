@@ -23,4 +23,15 @@
 // Added system calls numbers as indicated by project outline
 #define SYS_startLogging 22
 #define SYS_stopLogging 23
-#define SYS_nice 24
\ No newline at end of file
+#define SYS_nice 24
+#define SYS_setscheduler 25
+#define SYS_readtrace 26
+#define SYS_usleep 27
+#define SYS_getprocstats 28
+#define SYS_mlfqtune 29
+#define SYS_memstats 30
+#define SYS_mmap 31
+#define SYS_munmap 32
+#define SYS_lockstats 33
+#define SYS_setreadahead 34
+#define SYS_dropcache 35
\ No newline at end of file
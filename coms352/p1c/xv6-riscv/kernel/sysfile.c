@@ -503,3 +503,95 @@ sys_pipe(void)
   }
   return 0;
 }
+
+// map a file, or zero-filled memory with MAP_ANON, into the
+// process's memory. pages are read in (see vma.c) when the
+// process first touches them. returns the address, or -1.
+uint64
+sys_mmap(void)
+{
+  uint64 addr;
+  int len, prot, flags, off, perm;
+  uint filesz = 0;
+  struct file *f;
+  struct inode *ip = 0;
+  struct proc *p = myproc();
+
+  argaddr(0, &addr);
+  argint(1, &len);
+  argint(2, &prot);
+  argint(3, &flags);
+  argint(5, &off);
+
+  if(len <= 0 || (prot & ~(PROT_READ|PROT_WRITE|PROT_EXEC)) != 0)
+    return -1;
+  if(((flags & MAP_SHARED) != 0) == ((flags & MAP_PRIVATE) != 0))
+    return -1;
+  if((flags & ~(MAP_SHARED|MAP_PRIVATE|MAP_ANON)) != 0)
+    return -1;
+
+  if((flags & MAP_ANON) == 0){
+    if(argfd(4, 0, &f) < 0 || f->type != FD_INODE || !f->readable)
+      return -1;
+    if((flags & MAP_SHARED) && (prot & PROT_WRITE) && !f->writable)
+      return -1;
+    if(off < 0 || off % PGSIZE != 0)
+      return -1;
+    ip = f->ip;
+    ilock(ip);
+    if(ip->type != T_FILE){
+      iunlock(ip);
+      return -1;
+    }
+    if(off < ip->size)
+      filesz = ip->size - off < len ? ip->size - off : len;
+    iunlock(ip);
+  } else {
+    off = 0;
+  }
+
+  // every mapping is readable; RISC-V has no write-only pages.
+  perm = PTE_R;
+  if(prot & PROT_WRITE)
+    perm |= PTE_W;
+  if(prot & PROT_EXEC)
+    perm |= PTE_X;
+  return vmamap(p, addr, len, perm, flags & (MAP_SHARED|MAP_PRIVATE), ip, off, filesz);
+}
+
+// unmap [addr, addr+len) from regions created by mmap(),
+// writing MAP_SHARED pages back to their files.
+uint64
+sys_munmap(void)
+{
+  uint64 addr;
+  int len;
+
+  argaddr(0, &addr);
+  argint(1, &len);
+  if(len <= 0)
+    return -1;
+  return vmaremove(myproc(), addr, len);
+}
+
+// set the most blocks readi() reads ahead (0 for none),
+// or just return it if max is -1. returns the old setting.
+uint64
+sys_setreadahead(void)
+{
+  int max;
+
+  argint(0, &max);
+  if(max < -1)
+    return -1;
+  return setreadahead(max);
+}
+
+// empty the buffer cache of blocks no one is using, so that
+// they are read from disk again.
+uint64
+sys_dropcache(void)
+{
+  binval();
+  return 0;
+}
@@ -6,6 +6,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "vm.h"
+#include "memstat.h"
 
 uint64
 sys_exit(void)
@@ -47,8 +48,11 @@ sys_sbrk(void)
   argint(1, &t);
   addr = myproc()->sz;
 
-  if(t == SBRK_EAGER || n < 0) {
-    if(growproc(n) < 0) {
+  // the heap may not grow into an mmap() region.
+  if(n > 0 && (addr + n < addr || vmaoverlap(myproc(), addr, PGROUNDUP(addr + n))))
+    return -1;
+  if(t == SBRK_EAGER || t == SBRK_MEGA || n < 0) {
+    if(growproc(n, t == SBRK_MEGA) < 0) {
       return -1;
     }
   } else {
@@ -71,17 +75,21 @@ sys_pause(void)
   argint(0, &n);
   if(n < 0)
     n = 0;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(killed(myproc())){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  // wake at the start of tick ticks0 + n.
+  ticks0 = clockupdate();
+  return timersleep(ticktime(ticks0 + n));
+}
+
+// sleep for n microseconds.
+uint64
+sys_usleep(void)
+{
+  int n;
+
+  argint(0, &n);
+  if(n <= 0)
+    return 0;
+  return timersleep(r_time() + (uint64)n * (TIMEFREQ / 1000000));
 }
 
 uint64
@@ -93,15 +101,59 @@ sys_kill(void)
   return kkill(pid);
 }
 
+// copy unread scheduler trace events to user space.
+// returns the number of events copied.
+uint64
+sys_readtrace(void)
+{
+  uint64 buf;
+  int n;
+
+  argaddr(0, &buf);
+  argint(1, &n);
+  if(n < 0)
+    return -1;
+  return traceread(buf, n);
+}
+
+// copy the physical page allocator statistics to user space.
+uint64
+sys_memstats(void)
+{
+  uint64 addr;
+  struct memstats st;
+
+  argaddr(0, &addr);
+  kallocstats(&st);
+  slabstats(&st);
+  vmastats(&st);
+  swapstats(&st);
+  bstats(&st);
+  virtio_disk_stats(&st);
+  if(copyout(myproc()->pagetable, addr, (char *)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
+
+// copy up to n entries of spin-lock statistics to user
+// space; returns the number copied.
+uint64
+sys_lockstats(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  if(n < 0)
+    return -1;
+  return lockstats(addr, n);
+}
+
 // return how many clock tick interrupts have occurred
 // since start.
 uint64
 sys_uptime(void)
 {
-  uint xticks;
-
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
-  return xticks;
+  return clockupdate();
 }
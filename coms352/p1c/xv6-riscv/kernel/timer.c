@@ -0,0 +1,103 @@
+//
+// Timer events.
+//
+// A process that wants to sleep until a point in time, measured in
+// r_time() cycles, puts a struct timer on its kernel stack and links
+// it into a list sorted by deadline. The clock interrupt wakes up
+// every timer whose deadline has passed, and each CPU programs
+// stimecmp for the earlier of its next scheduling tick and the
+// first deadline, so deadlines need not fall on tick boundaries.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+struct timer {
+  uint64 deadline;     // r_time() at which to wake up
+  int fired;           // set by timerexpire()
+  struct timer *next;
+};
+
+static struct {
+  struct spinlock lock;
+  struct timer *head;  // sorted by deadline, earliest first
+} timers;
+
+void
+timerinit(void)
+{
+  initlock(&timers.lock, "timers");
+}
+
+// Sleep until r_time() reaches deadline.
+// Returns 0, or -1 if the process was killed while asleep.
+int
+timersleep(uint64 deadline)
+{
+  struct timer t, **tp;
+  struct proc *p = myproc();
+  int r = 0;
+
+  if(r_time() >= deadline)
+    return 0;
+
+  acquire(&timers.lock);
+  t.deadline = deadline;
+  t.fired = 0;
+  for(tp = &timers.head; *tp && (*tp)->deadline <= deadline; tp = &(*tp)->next)
+    ;
+  t.next = *tp;
+  *tp = &t;
+
+  // this CPU's next interrupt may be a whole tick away.
+  if(deadline < r_stimecmp())
+    w_stimecmp(deadline);
+
+  while(!t.fired){
+    if(killed(p)){
+      r = -1;
+      break;
+    }
+    sleep(&t, &timers.lock);
+  }
+
+  if(!t.fired){
+    for(tp = &timers.head; *tp != &t; tp = &(*tp)->next)
+      ;
+    *tp = t.next;
+  }
+  release(&timers.lock);
+  return r;
+}
+
+// Wake up the processes whose deadlines are at or before now.
+void
+timerexpire(uint64 now)
+{
+  struct timer *t;
+
+  acquire(&timers.lock);
+  while((t = timers.head) != 0 && t->deadline <= now){
+    timers.head = t->next;
+    t->fired = 1;
+    wakeup(t);
+  }
+  release(&timers.lock);
+}
+
+// The earliest pending deadline, or ~0 if there is none.
+uint64
+timernext(void)
+{
+  uint64 next;
+
+  acquire(&timers.lock);
+  next = timers.head ? timers.head->deadline : ~0ULL;
+  release(&timers.lock);
+  return next;
+}
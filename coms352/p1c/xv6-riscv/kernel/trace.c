@@ -0,0 +1,103 @@
+//
+// Scheduler trace log.
+//
+// Each CPU records events in its own fixed-size ring, with interrupts
+// off, so recording an event is a handful of stores and needs no lock.
+// When a ring is full the oldest events are overwritten.
+//
+// readtrace() copies the events that have not been read yet out to
+// user space; it does not stop writers, so it re-checks each event's
+// slot after copying it and drops events that were overwritten.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "defs.h"
+#include "trace.h"
+
+#define NTRACE 1024  // events per CPU; must be a power of two
+
+struct tracering {
+  uint64 head;                   // total events written; next slot is head % NTRACE
+  struct traceevent ev[NTRACE];
+};
+
+static struct tracering rings[NCPU];
+
+// Readers take this lock so that each event is read only once.
+// It is a sleep-lock since copyout() may need to fault in a page.
+static struct {
+  struct sleeplock lock;
+  uint64 tail[NCPU];             // first event not yet read, per CPU
+} reader;
+
+void
+traceinit(void)
+{
+  initsleeplock(&reader.lock, "trace");
+}
+
+// Record an event in this CPU's ring.
+void
+trace(int type, int pid, int arg)
+{
+  struct tracering *r;
+  struct traceevent *e;
+  int id;
+
+  push_off();
+  id = cpuid();
+  r = &rings[id];
+  e = &r->ev[r->head & (NTRACE - 1)];
+  e->time = r_time();
+  e->ticks = ticks;
+  e->type = type;
+  e->cpu = id;
+  e->pid = pid;
+  e->arg = arg;
+  // publish the event before advancing head.
+  __sync_synchronize();
+  r->head++;
+  pop_off();
+}
+
+// Copy up to n unread events to user address dst.
+// Returns the number of events copied, or -1 on error.
+int
+traceread(uint64 dst, int n)
+{
+  struct proc *p = myproc();
+  struct traceevent e;
+  struct tracering *r;
+  uint64 head, i;
+  int id, copied = 0;
+
+  acquiresleep(&reader.lock);
+  for(id = 0; id < NCPU && copied < n; id++){
+    r = &rings[id];
+    head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    i = reader.tail[id];
+    if(head - i > NTRACE)
+      i = head - NTRACE;        // the oldest unread events were overwritten
+    for(; i < head && copied < n; i++){
+      e = r->ev[i & (NTRACE - 1)];
+      __sync_synchronize();
+      // the writer may have lapped us while we copied the slot.
+      if(__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - i > NTRACE)
+        continue;
+      if(copyout(p->pagetable, dst + copied * sizeof(e), (char*)&e, sizeof(e)) < 0){
+        releasesleep(&reader.lock);
+        return -1;
+      }
+      copied++;
+    }
+    reader.tail[id] = i;
+  }
+  releasesleep(&reader.lock);
+  return copied;
+}
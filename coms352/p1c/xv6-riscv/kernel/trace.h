@@ -0,0 +1,15 @@
+// Scheduler trace events, recorded while logging is on
+// (startLogging()) and read back with readtrace().
+
+#define TRACE_RUN    1   // pid was dispatched
+#define TRACE_NICE   2   // pid's nice value was set to arg
+#define TRACE_SCHED  3   // scheduling policy was set to arg
+
+struct traceevent {
+  uint64 time;   // r_time() when the event happened
+  uint ticks;    // ticks when the event happened
+  short type;    // TRACE_*
+  short cpu;     // CPU that recorded the event
+  int pid;
+  int arg;
+};
@@ -8,6 +8,7 @@
 
 struct spinlock tickslock;
 uint ticks;
+static uint64 tickbase;   // r_time() at which tick 0 began
 
 extern char trampoline[], uservec[];
 
@@ -20,6 +21,7 @@ void
 trapinit(void)
 {
   initlock(&tickslock, "time");
+  tickbase = r_time();
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -38,6 +40,7 @@ uint64
 usertrap(void)
 {
   int which_dev = 0;
+  uint64 scause;
 
   if((r_sstatus() & SSTATUS_SPP) != 0)
     panic("usertrap: not from user mode");
@@ -68,9 +71,18 @@ usertrap(void)
     syscall();
   } else if((which_dev = devintr()) != 0){
     // ok
-  } else if((r_scause() == 15 || r_scause() == 13) &&
-            vmfault(p->pagetable, r_stval(), (r_scause() == 13)? 1 : 0) != 0) {
-    // page fault on lazily-allocated page
+  } else if((scause = r_scause()) == 12 || scause == 13 || scause == 15){
+    // page fault on a lazily-allocated, copy-on-write or
+    // demand-paged page. reading the page in from the file
+    // sleeps, so save the fault's registers before enabling
+    // interrupts.
+    uint64 stval = r_stval();
+    intr_on();
+    if(vmfault(p->pagetable, stval, scause != 15) == 0){
+      printf("usertrap(): unexpected scause 0x%lx pid=%d\n", scause, p->pid);
+      printf("            sepc=0x%lx stval=0x%lx\n", p->trapframe->epc, stval);
+      setkilled(p);
+    }
   } else {
     printf("usertrap(): unexpected scause 0x%lx pid=%d\n", r_scause(), p->pid);
     printf("            sepc=0x%lx stval=0x%lx\n", r_sepc(), r_stval());
@@ -161,26 +173,87 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
+// Bring ticks up to date and return it.
+// An idle CPU does not take an interrupt every tick, so
+// ticks is derived from r_time() rather than counted.
+uint
+clockupdate(void)
+{
+  uint t;
+
+  acquire(&tickslock);
+  t = (r_time() - tickbase) / TICKCYCLES;
+  if(t > ticks)
+    ticks = t;
+  t = ticks;
+  release(&tickslock);
+  return t;
+}
+
+// The r_time() at which tick t begins.
+uint64
+ticktime(uint t)
+{
+  return tickbase + (uint64)t * TICKCYCLES;
+}
+
+// Program this CPU's next timer interrupt for the earlier of the
+// next timer event and, if the CPU has a process to run, its next
+// scheduling tick. An idle CPU still wakes every IDLETICKS ticks
+// to look for work to steal from other CPUs.
+// Interrupts must be disabled.
+void
+clockarm(int idle)
+{
+  struct cpu *c = mycpu();
+  uint64 when, next;
+
+  if(idle)
+    when = r_time() + IDLETICKS * TICKCYCLES;
+  else
+    when = c->nexttick;
+  next = timernext();
+  if(next < when)
+    when = next;
+
+  // this also clears the interrupt request.
+  w_stimecmp(when);
+}
+
+// Interrupt CPU id, to wake it from wfi in scheduler().
 void
+cpuwake(int id)
+{
+  *(volatile uint32*)CLINT_MSIP(id) = 1;
+}
+
+// Returns 1 if a scheduling tick has passed, 0 if this
+// interrupt was only for a timer event.
+int
 clockintr()
 {
-  if(cpuid() == 0){
-    acquire(&tickslock);
-    ticks++;
-    wakeup(&ticks);
-    release(&tickslock);
+  struct cpu *c = mycpu();
+  uint64 now = r_time();
+  int tick = 0;
+
+  clockupdate();
+  timerexpire(now);
+
+  if(now >= c->nexttick){
+    tick = 1;
+    // TICKCYCLES is about a tenth of a second.
+    c->nexttick = now + TICKCYCLES;
   }
 
-  // ask for the next timer interrupt. this also clears
-  // the interrupt request. 1000000 is about a tenth
-  // of a second.
-  w_stimecmp(r_time() + 1000000);
+  // ask for the next timer interrupt.
+  clockarm(0);
+  return tick;
 }
 
 // check if it's an external interrupt or software interrupt,
 // and handle it.
-// returns 2 if timer interrupt,
-// 1 if other device,
+// returns 2 if timer interrupt at a scheduling tick,
+// 1 if other device or timer event,
 // 0 if not recognized.
 int
 devintr()
@@ -210,8 +283,12 @@ devintr()
     return 1;
   } else if(scause == 0x8000000000000005L){
     // timer interrupt.
-    clockintr();
-    return 2;
+    return clockintr() ? 2 : 1;
+  } else if(scause == 0x8000000000000001L){
+    // software interrupt from machinevec: another CPU woke this
+    // one with cpuwake(). the scheduler loop will find the work.
+    w_sip(r_sip() & ~SIP_SSIP);
+    return 1;
   } else {
     return 0;
   }
@@ -15,6 +15,7 @@
 #include "fs.h"
 #include "buf.h"
 #include "virtio.h"
+#include "memstat.h"
 
 // the address of virtio mmio register r.
 #define R(r) ((volatile uint32 *)(VIRTIO0 + (r)))
@@ -45,8 +46,11 @@ static struct disk {
   // track info about in-flight operations,
   // for use when completion interrupt arrives.
   // indexed by first descriptor index of chain.
+  // the status is in the first descriptor's entry, and each
+  // data descriptor's entry has the busy flag of its data.
   struct {
-    struct buf *b;
+    int *busy;      // cleared, and woken up, when the operation is done
+    struct buf *b;  // the buffer the data is in, if any
     char status;
   } info[NUM];
 
@@ -55,6 +59,8 @@ static struct disk {
   struct virtio_blk_req ops[NUM];
   
   struct spinlock vdisk_lock;
+
+  uint64 nreq, nblock, nintr;  // operations, blocks moved, interrupts
   
 } disk;
 
@@ -116,6 +122,8 @@ virtio_disk_init(void)
     panic("virtio disk has no queue 0");
   if(max < NUM)
     panic("virtio disk max queue too short");
+  if(MAXRUN + 2 > NUM)
+    panic("virtio disk MAXRUN too big");
 
   // allocate and zero queue memory.
   disk.desc = kalloc();
@@ -196,12 +204,11 @@ free_chain(int i)
   }
 }
 
-// allocate three descriptors (they need not be contiguous).
-// disk transfers always use three descriptors.
+// allocate n descriptors (they need not be contiguous).
 static int
-alloc3_desc(int *idx)
+alloc_descs(int *idx, int n)
 {
-  for(int i = 0; i < 3; i++){
+  for(int i = 0; i < n; i++){
     idx[i] = alloc_desc();
     if(idx[i] < 0){
       for(int j = 0; j < i; j++)
@@ -212,27 +219,39 @@ alloc3_desc(int *idx)
   return 0;
 }
 
-void
-virtio_disk_rw(struct buf *b, int write)
+// start reading or writing n pieces of len bytes each (a multiple
+// of BSIZE), at data[0..n-1], which are consecutive on the disk
+// starting at block blockno, as one operation, and return without
+// waiting for the disk. *busy[i] is set while the disk owns
+// data[i]; virtio_disk_intr() clears it and wakes up sleepers on
+// busy[i]. data[i] is in buffer b[i], if b is not 0.
+// may sleep until descriptors are free.
+static void
+virtio_disk_submit(uint blockno, int n, void **data, uint len, int **busy,
+                   struct buf **b, int write)
 {
-  uint64 sector = b->blockno * (BSIZE / 512);
+  uint64 sector = (uint64)blockno * (BSIZE / 512);
+  int idx[MAXRUN+2];
+
+  if(n < 1 || n > MAXRUN)
+    panic("virtio_disk_submit");
 
   acquire(&disk.vdisk_lock);
 
   // the spec's Section 5.2 says that legacy block operations use
-  // three descriptors: one for type/reserved/sector, one for the
-  // data, one for a 1-byte status result.
+  // a descriptor for type/reserved/sector, then descriptors for
+  // the data, then one for a 1-byte status result. the device
+  // gathers (or scatters) the data descriptors in order.
 
-  // allocate the three descriptors.
-  int idx[3];
+  // allocate the n+2 descriptors.
   while(1){
-    if(alloc3_desc(idx) == 0) {
+    if(alloc_descs(idx, n+2) == 0) {
       break;
     }
     sleep(&disk.free[0], &disk.vdisk_lock);
   }
 
-  // format the three descriptors.
+  // format the descriptors.
   // qemu's virtio-blk.c reads them.
 
   struct virtio_blk_req *buf0 = &disk.ops[idx[0]];
@@ -249,24 +268,27 @@ virtio_disk_rw(struct buf *b, int write)
   disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
   disk.desc[idx[0]].next = idx[1];
 
-  disk.desc[idx[1]].addr = (uint64) b->data;
-  disk.desc[idx[1]].len = BSIZE;
-  if(write)
-    disk.desc[idx[1]].flags = 0; // device reads b->data
-  else
-    disk.desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes b->data
-  disk.desc[idx[1]].flags |= VRING_DESC_F_NEXT;
-  disk.desc[idx[1]].next = idx[2];
+  for(int i = 1; i <= n; i++){
+    disk.desc[idx[i]].addr = (uint64) data[i-1];
+    disk.desc[idx[i]].len = len;
+    if(write)
+      disk.desc[idx[i]].flags = 0; // device reads data
+    else
+      disk.desc[idx[i]].flags = VRING_DESC_F_WRITE; // device writes data
+    disk.desc[idx[i]].flags |= VRING_DESC_F_NEXT;
+    disk.desc[idx[i]].next = idx[i+1];
+
+    // record the busy flag for virtio_disk_intr().
+    *busy[i-1] = 1;
+    disk.info[idx[i]].busy = busy[i-1];
+    disk.info[idx[i]].b = b ? b[i-1] : 0;
+  }
 
   disk.info[idx[0]].status = 0xff; // device writes 0 on success
-  disk.desc[idx[2]].addr = (uint64) &disk.info[idx[0]].status;
-  disk.desc[idx[2]].len = 1;
-  disk.desc[idx[2]].flags = VRING_DESC_F_WRITE; // device writes the status
-  disk.desc[idx[2]].next = 0;
-
-  // record struct buf for virtio_disk_intr().
-  b->disk = 1;
-  disk.info[idx[0]].b = b;
+  disk.desc[idx[n+1]].addr = (uint64) &disk.info[idx[0]].status;
+  disk.desc[idx[n+1]].len = 1;
+  disk.desc[idx[n+1]].flags = VRING_DESC_F_WRITE; // device writes the status
+  disk.desc[idx[n+1]].next = 0;
 
   // tell the device the first index in our chain of descriptors.
   disk.avail->ring[disk.avail->idx % NUM] = idx[0];
@@ -280,14 +302,82 @@ virtio_disk_rw(struct buf *b, int write)
 
   *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
 
-  // Wait for virtio_disk_intr() to say request has finished.
-  while(b->disk == 1) {
-    sleep(b, &disk.vdisk_lock);
+  disk.nreq++;
+  disk.nblock += n * len / BSIZE;
+  release(&disk.vdisk_lock);
+}
+
+// wait for the operation that set *busy to finish.
+static void
+virtio_disk_done(int *busy)
+{
+  acquire(&disk.vdisk_lock);
+  while(*busy == 1) {
+    sleep(busy, &disk.vdisk_lock);
+  }
+  release(&disk.vdisk_lock);
+}
+
+// start reading or writing the n buffers in b, which must hold
+// consecutive blocks, as one operation, without waiting.
+// the disk owns each buffer until virtio_disk_wait() on it returns.
+void
+virtio_disk_startv(struct buf **b, int n, int write)
+{
+  void *data[MAXRUN];
+  int *busy[MAXRUN];
+
+  if(n > MAXRUN)
+    panic("virtio_disk_startv");
+  for(int i = 0; i < n; i++){
+    if(b[i]->blockno != b[0]->blockno + i)
+      panic("virtio_disk_startv: not consecutive");
+    data[i] = b[i]->data;
+    busy[i] = &b[i]->disk;
   }
+  virtio_disk_submit(b[0]->blockno, n, data, BSIZE, busy, b, write);
+}
+
+// start reading or writing b, without waiting.
+void
+virtio_disk_start(struct buf *b, int write)
+{
+  virtio_disk_startv(&b, 1, write);
+}
+
+// wait for the operation virtio_disk_start() began on b.
+void
+virtio_disk_wait(struct buf *b)
+{
+  virtio_disk_done(&b->disk);
+}
+
+void
+virtio_disk_rw(struct buf *b, int write)
+{
+  virtio_disk_start(b, write);
+  virtio_disk_wait(b);
+}
 
-  disk.info[idx[0]].b = 0;
-  free_chain(idx[0]);
+// read or write the page at pa from or to the PGSIZE/BSIZE
+// disk blocks starting at blockno, in one operation.
+void
+virtio_disk_rwpage(uint blockno, void *pa, int write)
+{
+  int busy, *busyp = &busy;
 
+  virtio_disk_submit(blockno, 1, &pa, PGSIZE, &busyp, 0, write);
+  virtio_disk_done(&busy);
+}
+
+// Fill in the disk statistics for memstats().
+void
+virtio_disk_stats(struct memstats *st)
+{
+  acquire(&disk.vdisk_lock);
+  st->diskreqs = disk.nreq;
+  st->diskblocks = disk.nblock;
+  st->diskintrs = disk.nintr;
   release(&disk.vdisk_lock);
 }
 
@@ -303,6 +393,7 @@ virtio_disk_intr()
   // completion entries in this interrupt, and have nothing to do
   // in the next interrupt, which is harmless.
   *R(VIRTIO_MMIO_INTERRUPT_ACK) = *R(VIRTIO_MMIO_INTERRUPT_STATUS) & 0x3;
+  disk.nintr++;
 
   __sync_synchronize();
 
@@ -316,9 +407,24 @@ virtio_disk_intr()
     if(disk.info[id].status != 0)
       panic("virtio_disk_intr status");
 
-    struct buf *b = disk.info[id].b;
-    b->disk = 0;   // disk is done with buf
-    wakeup(b);
+    // the disk is done with the data of each data descriptor.
+    for(int d = id; ; d = disk.desc[d].next){
+      int *busy = disk.info[d].busy;
+      struct buf *b = disk.info[d].b;
+      if(busy){
+        disk.info[d].busy = 0;
+        disk.info[d].b = 0;
+        *busy = 0;
+        wakeup(busy);
+        if(b && b->ahead)
+          breadaheaddone(b);   // no one waits for a read-ahead
+      }
+      if((disk.desc[d].flags & VRING_DESC_F_NEXT) == 0)
+        break;
+    }
+    // no one waits for the descriptors now, so free them
+    // here, which also wakes up submitters waiting for some.
+    free_chain(id);
 
     disk.used_idx += 1;
   }
@@ -29,6 +29,9 @@ kvmmake(void)
   // uart registers
   kvmmap(kpgtbl, UART0, UART0, PGSIZE, PTE_R | PTE_W);
 
+  // CLINT MSIP registers, for wakeup interrupts to other CPUs
+  kvmmap(kpgtbl, CLINT, CLINT, PGSIZE, PTE_R | PTE_W);
+
   // virtio mmio disk interface
   kvmmap(kpgtbl, VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W);
 
@@ -51,14 +54,32 @@ kvmmake(void)
   return kpgtbl;
 }
 
-// add a mapping to the kernel page table.
+// add a mapping to the kernel page table, using 2 MiB
+// megapages wherever va and pa allow it.
 // only used when booting.
 // does not flush TLB or enable paging.
 void
 kvmmap(pagetable_t kpgtbl, uint64 va, uint64 pa, uint64 sz, int perm)
 {
-  if(mappages(kpgtbl, va, sz, pa, perm) != 0)
-    panic("kvmmap");
+  uint64 n;
+
+  while(sz > 0){
+    if(va % MEGASIZE == 0 && pa % MEGASIZE == 0 && sz >= MEGASIZE){
+      n = MEGASIZE;
+      if(mapmega(kpgtbl, va, pa, perm) != 0)
+        panic("kvmmap");
+    } else {
+      // 4 KiB pages up to the next megapage boundary
+      n = MEGAROUNDUP(va + 1) - va;
+      if(n > sz)
+        n = sz;
+      if(mappages(kpgtbl, va, n, pa, perm) != 0)
+        panic("kvmmap");
+    }
+    va += n;
+    pa += n;
+    sz -= n;
+  }
 }
 
 // Initialize the kernel_pagetable, shared by all CPUs.
@@ -94,24 +115,39 @@ kvminithart()
 //   21..29 -- 9 bits of level-1 index.
 //   12..20 -- 9 bits of level-0 index.
 //    0..11 -- 12 bits of byte offset within the page.
+//
+// If va lies in a 2 MiB megapage, returns the megapage's
+// level-1 PTE; walklevel() says which level a PTE is at.
 pte_t *
 walk(pagetable_t pagetable, uint64 va, int alloc)
+{
+  int level;
+
+  return walklevel(pagetable, va, alloc, 0, &level);
+}
+
+// Like walk(), but descend only as far as level stop (0 for a
+// 4 KiB page, 1 for a megapage), and set *level to the level of
+// the returned PTE, which is higher than stop for a megapage.
+pte_t *
+walklevel(pagetable_t pagetable, uint64 va, int alloc, int stop, int *level)
 {
   if(va >= MAXVA)
     panic("walk");
 
-  for(int level = 2; level > 0; level--) {
-    pte_t *pte = &pagetable[PX(level, va)];
+  for(*level = 2; *level > stop; (*level)--) {
+    pte_t *pte = &pagetable[PX(*level, va)];
     if(*pte & PTE_V) {
+      if(PTE_LEAF(*pte))
+        return pte;
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
-      if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
+      if(!alloc || (pagetable = (pde_t*)kzalloc()) == 0)
         return 0;
-      memset(pagetable, 0, PGSIZE);
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
-  return &pagetable[PX(0, va)];
+  return &pagetable[PX(stop, va)];
 }
 
 // Look up a virtual address, return the physical address,
@@ -122,11 +158,12 @@ walkaddr(pagetable_t pagetable, uint64 va)
 {
   pte_t *pte;
   uint64 pa;
+  int level;
 
   if(va >= MAXVA)
     return 0;
 
-  pte = walk(pagetable, va, 0);
+  pte = walklevel(pagetable, va, 0, 0, &level);
   if(pte == 0)
     return 0;
   if((*pte & PTE_V) == 0)
@@ -134,6 +171,8 @@ walkaddr(pagetable_t pagetable, uint64 va)
   if((*pte & PTE_U) == 0)
     return 0;
   pa = PTE2PA(*pte);
+  if(level > 0)  // the 4 KiB page within the megapage
+    pa += PGROUNDDOWN(va) & (MEGASIZE - 1);
   return pa;
 }
 
@@ -173,41 +212,107 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
   return 0;
 }
 
+// Create a level-1 PTE mapping the 2 MiB megapage at va to pa.
+// va and pa MUST be megapage-aligned.
+// Returns 0 on success, -1 if walk() couldn't
+// allocate a needed page-table page.
+int
+mapmega(pagetable_t pagetable, uint64 va, uint64 pa, int perm)
+{
+  pte_t *pte;
+  int level;
+
+  if((va % MEGASIZE) != 0 || (pa % MEGASIZE) != 0)
+    panic("mapmega: not aligned");
+  if((pte = walklevel(pagetable, va, 1, 1, &level)) == 0)
+    return -1;
+  if(*pte & PTE_V)
+    panic("mapmega: remap");
+  *pte = PA2PTE(pa) | perm | PTE_V;
+  return 0;
+}
+
+// Replace the megapage PTE *pte with a page-table page of
+// 512 PTEs mapping the same memory, so that its 4 KiB pages
+// can be unmapped, shared and freed one at a time.
+// Returns 0 on success, -1 if out of memory.
+static int
+megasplit(pte_t *pte)
+{
+  pagetable_t pt;
+  uint64 pa = PTE2PA(*pte);
+
+  if((pt = (pagetable_t) kzalloc()) == 0)
+    return -1;
+  for(int i = 0; i < 512; i++)
+    pt[i] = PA2PTE(pa + i * PGSIZE) | PTE_FLAGS(*pte);
+  ksplitpages((void*)pa, MEGAORDER);
+  *pte = PA2PTE(pt) | PTE_V;
+  sfence_vma();
+  return 0;
+}
+
 // create an empty user page table.
 // returns 0 if out of memory.
 pagetable_t
 uvmcreate()
 {
   pagetable_t pagetable;
-  pagetable = (pagetable_t) kalloc();
+  pagetable = (pagetable_t) kzalloc();
   if(pagetable == 0)
     return 0;
-  memset(pagetable, 0, PGSIZE);
   return pagetable;
 }
 
 // Remove npages of mappings starting from va. va must be
 // page-aligned. It's OK if the mappings don't exist.
 // Optionally free the physical memory.
+// Each PTE is read and cleared with interrupts off: a process
+// preempted here is RUNNABLE, and reclaim() on another CPU could
+// otherwise page the page out between the two.
 void
 uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 {
-  uint64 a;
-  pte_t *pte;
+  uint64 a, end = va + npages*PGSIZE;
+  pte_t *pte, old;
+  int level;
 
   if((va % PGSIZE) != 0)
     panic("uvmunmap: not aligned");
 
-  for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
-    if((pte = walk(pagetable, a, 0)) == 0) // leaf page table entry allocated?
-      continue;   
-    if((*pte & PTE_V) == 0)  // has physical page been allocated?
+  for(a = va; a < end; a += PGSIZE){
+    push_off();
+    pte = walklevel(pagetable, a, 0, 0, &level); // leaf page table entry allocated?
+    if(pte && (*pte & PTE_V) && level > 0 &&
+       (a % MEGASIZE != 0 || a + MEGASIZE > end)){
+      // a megapage the range does not cover: split it and
+      // unmap its pages one by one. a shrink that cuts one has
+      // split it already with uvmsplit(), which may fail.
+      if(megasplit(pte) != 0)
+        panic("uvmunmap: split");
+      pte = walk(pagetable, a, 0);
+      level = 0;
+    }
+    old = pte ? *pte : 0;
+    if(old & (PTE_V|PTE_SWAP))
+      *pte = 0;
+    pop_off();
+
+    if(old & PTE_SWAP){      // paged out?
+      swapput(old >> 10);
       continue;
-    if(do_free){
-      uint64 pa = PTE2PA(*pte);
-      kfree((void*)pa);
     }
-    *pte = 0;
+    if((old & PTE_V) == 0)   // has physical page been allocated?
+      continue;
+    if(level > 0){
+      // a whole megapage.
+      if(do_free)
+        kfreepages((void*)PTE2PA(old), MEGAORDER);
+      a += MEGASIZE - PGSIZE;
+      continue;
+    }
+    if(do_free)
+      kfree((void*)PTE2PA(old));
   }
 }
 
@@ -224,12 +329,11 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
 
   oldsz = PGROUNDUP(oldsz);
   for(a = oldsz; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    mem = kallocuser(1);
     if(mem == 0){
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
     if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_R|PTE_U|xperm) != 0){
       kfree(mem);
       uvmdealloc(pagetable, a, oldsz);
@@ -239,6 +343,87 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
   return newsz;
 }
 
+// Can the 2 MiB region at megapage-aligned va take a megapage?
+// Shrinking with uvmunmap() leaves level-0 page-table pages in
+// place, so free one that no longer maps anything. A level-0 table
+// still in use means va stays in 4 KiB pages.
+static int
+megaslot(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  pagetable_t l0;
+  int level, i;
+
+  if((pte = walklevel(pagetable, va, 0, 1, &level)) == 0 ||
+     (*pte & PTE_V) == 0)
+    return 1;
+  if(PTE_LEAF(*pte))
+    return 0;
+  l0 = (pagetable_t)PTE2PA(*pte);
+  for(i = 0; i < 512; i++)
+    if(l0[i] != 0)
+      return 0;
+  *pte = 0;
+  kfree(l0);
+  return 1;
+}
+
+// Like uvmalloc(), but back each whole 2 MiB-aligned megapage in
+// the range with a megapage when the allocator has a free 2 MiB
+// block, and use 4 KiB pages for the rest.
+// Returns new size or 0 on error.
+uint64
+uvmallocmega(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
+{
+  char *mem;
+  uint64 a, end;
+
+  if(newsz < oldsz)
+    return oldsz;
+
+  a = PGROUNDUP(oldsz);
+  while(a < newsz){
+    if(a % MEGASIZE == 0 && a + MEGASIZE <= newsz && megaslot(pagetable, a) &&
+       (mem = kallocpages(MEGAORDER)) != 0){
+      memset(mem, 0, MEGASIZE);
+      if(mapmega(pagetable, a, (uint64)mem, PTE_R|PTE_U|xperm) != 0){
+        kfreepages(mem, MEGAORDER);
+        uvmdealloc(pagetable, a, oldsz);
+        return 0;
+      }
+      a += MEGASIZE;
+      continue;
+    }
+    // 4 KiB pages up to the next megapage boundary
+    end = MEGAROUNDUP(a + 1);
+    if(end > newsz)
+      end = newsz;
+    if(uvmalloc(pagetable, a, end, xperm) == 0){
+      uvmdealloc(pagetable, a, oldsz);
+      return 0;
+    }
+    a = PGROUNDUP(end);
+  }
+  return newsz;
+}
+
+// Split the megapage, if any, that va falls inside of, so that
+// uvmdealloc() to va need not allocate a page-table page.
+// Returns 0 on success, -1 if out of memory.
+int
+uvmsplit(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  int level;
+
+  if(va % MEGASIZE == 0)
+    return 0;
+  pte = walklevel(pagetable, va, 0, 0, &level);
+  if(pte && (*pte & PTE_V) && level > 0)
+    return megasplit(pte);
+  return 0;
+}
+
 // Deallocate user pages to bring the process size from oldsz to
 // newsz.  oldsz and newsz need not be page-aligned, nor does newsz
 // need to be less than oldsz.  oldsz can be larger than the actual
@@ -289,37 +474,71 @@ uvmfree(pagetable_t pagetable, uint64 sz)
 
 // Given a parent process's page table, copy
 // its memory into a child's page table.
-// Copies both the page table and the
-// physical memory.
+// Copies only the page table: parent and child
+// share the physical pages, and writable pages
+// become read-only copy-on-write pages in both,
+// copied by cowcopy() on the first write.
+// The parent's megapages are split into 4 KiB pages
+// first, so that they can be shared page by page.
 // returns 0 on success, -1 on failure.
 // frees any allocated pages on failure.
 int
 uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
 {
-  pte_t *pte;
-  uint64 pa, i;
-  uint flags;
-  char *mem;
+  return uvmdup(old, new, 0, sz, 1);
+}
 
-  for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walk(old, i, 0)) == 0)
-      continue;   // page table entry hasn't been allocated
-    if((*pte & PTE_V) == 0)
-      continue;   // physical page hasn't been allocated
-    pa = PTE2PA(*pte);
-    flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto err;
-    memmove(mem, (char*)pa, PGSIZE);
-    if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0){
-      kfree(mem);
+// map the pages of old from start to end into new, as
+// uvmcopy() does. if cow is 0, writable pages stay writable
+// and parent and child write to the same memory (a shared
+// mmap() region). each PTE is read, updated and shared with
+// interrupts off, like uvmunmap(), so reclaim() cannot page
+// the page out from under fork().
+int
+uvmdup(pagetable_t old, pagetable_t new, uint64 start, uint64 end, int cow)
+{
+  pte_t *pte, *npte;
+  uint64 pa, i;
+  int level;
+
+  for(i = start; i < end; i += PGSIZE){
+    push_off();
+    if((pte = walklevel(old, i, 0, 0, &level)) == 0 ||
+       (*pte & (PTE_V|PTE_SWAP)) == 0){
+      pop_off();
+      continue;   // no page here
+    }
+    if((npte = walk(new, i, 1)) == 0){
+      pop_off();
       goto err;
     }
+    if(*npte & PTE_V)
+      panic("uvmdup: remap");
+    if(*pte & PTE_SWAP){
+      // paged out: the child's PTE names the same swap slot.
+      *npte = *pte;
+      swapdup(*pte >> 10);
+      pop_off();
+      continue;
+    }
+    if(level > 0){
+      if(megasplit(pte) != 0){
+        pop_off();
+        goto err;
+      }
+      pte = walk(old, i, 0);
+    }
+    if(cow && (*pte & PTE_W))
+      *pte = (*pte & ~PTE_W) | PTE_COW;
+    pa = PTE2PA(*pte);
+    *npte = PA2PTE(pa) | PTE_FLAGS(*pte) | PTE_V;
+    kdup((void*)pa);
+    pop_off();
   }
   return 0;
 
  err:
-  uvmunmap(new, 0, i / PGSIZE, 1);
+  uvmunmap(new, start, (i - start) / PGSIZE, 1);
   return -1;
 }
 
@@ -336,40 +555,111 @@ uvmclear(pagetable_t pagetable, uint64 va)
   *pte &= ~PTE_U;
 }
 
+// Find the PTE for user address va, for the copy functions
+// below. The calling process's software TLB (p->utlb) remembers
+// the 4 KiB page table that held the last page they translated;
+// consecutive user pages usually share one, so after the first
+// three-level walk each further page costs one load. syscall()
+// empties the TLB, so it never outlives the page table it points
+// into. Sets *mega if the PTE maps a megapage, which is not cached.
+// Returns 0 if there is no PTE.
+static pte_t *
+utlbwalk(pagetable_t pagetable, uint64 va, int *mega)
+{
+  struct utlb *t = &myproc()->utlb;
+  pte_t *pte;
+  int level;
+
+  *mega = 0;
+  if(t->pagetable == pagetable && t->base == MEGAROUNDDOWN(va))
+    return &t->pt[PX(0, va)];
+
+  pte = walklevel(pagetable, va, 0, 0, &level);
+  if(pte == 0)
+    return 0;
+  if(level > 0){
+    *mega = 1;
+    return pte;
+  }
+  t->pagetable = pagetable;
+  t->base = MEGAROUNDDOWN(va);
+  t->pt = pte - PX(0, va);
+  return pte;
+}
+
+// Return the physical address of the user page at va0 for a copy,
+// or 0 if it must be faulted in first or cannot be accessed. A page
+// to store to must be writable, so not copy-on-write.
+static uint64
+uaddr(pagetable_t pagetable, uint64 va0, int store)
+{
+  pte_t *pte;
+  int mega;
+
+  if(va0 >= MAXVA)
+    return 0;
+  pte = utlbwalk(pagetable, va0, &mega);
+  if(pte == 0 || (*pte & (PTE_V|PTE_U)) != (PTE_V|PTE_U))
+    return 0;
+  if(store){
+    if((*pte & PTE_W) == 0)
+      return 0;
+    // a store by the kernel, unlike one by the process, does
+    // not set the dirty bit that mmap() write-back looks at.
+    *pte |= PTE_D;
+  }
+  if(mega)  // the 4 KiB page within the megapage
+    return PTE2PA(*pte) + (va0 & (MEGASIZE - 1));
+  return PTE2PA(*pte);
+}
+
+// Copy n bytes between kernel address kva and user address va,
+// which lie within one page: to user space if store is set, else
+// from it. Faults the page in first if need be, which may sleep.
+// The lookup and the copy run with interrupts off, so the process
+// cannot be preempted in between and have the page paged out
+// (reclaim() leaves running processes alone).
+// Returns 0 on success, -1 on error.
+static int
+ucopy(pagetable_t pagetable, uint64 va, char *kva, uint64 n, int store)
+{
+  uint64 va0 = PGROUNDDOWN(va), pa0;
+
+  for(;;){
+    push_off();
+    if((pa0 = uaddr(pagetable, va0, store)) != 0){
+      if(store)
+        memmove((void *)(pa0 + (va - va0)), kva, n);
+      else
+        memmove(kva, (void *)(pa0 + (va - va0)), n);
+      pop_off();
+      return 0;
+    }
+    pop_off();
+    // fault it in, copy a copy-on-write page, or give up.
+    if(vmfault(pagetable, va0, !store) == 0)
+      return -1;
+  }
+}
+
 // Copy from kernel to user.
 // Copy len bytes from src to virtual address dstva in a given page table.
 // Return 0 on success, -1 on error.
 int
 copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 {
-  uint64 n, va0, pa0;
-  pte_t *pte;
+  uint64 n;
 
   while(len > 0){
-    va0 = PGROUNDDOWN(dstva);
-    if(va0 >= MAXVA)
-      return -1;
-  
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0) {
-      if((pa0 = vmfault(pagetable, va0, 0)) == 0) {
-        return -1;
-      }
-    }
-
-    pte = walk(pagetable, va0, 0);
-    // forbid copyout over read-only user text pages.
-    if((*pte & PTE_W) == 0)
-      return -1;
-      
-    n = PGSIZE - (dstva - va0);
+    n = PGSIZE - (dstva - PGROUNDDOWN(dstva));
     if(n > len)
       n = len;
-    memmove((void *)(pa0 + (dstva - va0)), src, n);
+    if(ucopy(pagetable, dstva, src, n, 1) < 0)
+      return -1;
 
     len -= n;
     src += n;
-    dstva = va0 + PGSIZE;
+    dstva += n;
   }
   return 0;
 }
@@ -380,91 +670,113 @@ copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 int
 copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 {
-  uint64 n, va0, pa0;
+  uint64 n;
 
   while(len > 0){
-    va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0) {
-      if((pa0 = vmfault(pagetable, va0, 0)) == 0) {
-        return -1;
-      }
-    }
-    n = PGSIZE - (srcva - va0);
+    n = PGSIZE - (srcva - PGROUNDDOWN(srcva));
     if(n > len)
       n = len;
-    memmove(dst, (void *)(pa0 + (srcva - va0)), n);
+    if(ucopy(pagetable, srcva, dst, n, 0) < 0)
+      return -1;
 
     len -= n;
     dst += n;
-    srcva = va0 + PGSIZE;
+    srcva += n;
   }
   return 0;
 }
 
+// does the 64-bit word w contain a zero byte?
+#define HASZERO(w) (((w) - 0x0101010101010101UL) & ~(w) & 0x8080808080808080UL)
+
 // Copy a null-terminated string from user to kernel.
 // Copy bytes to dst from virtual address srcva in a given page table,
 // until a '\0', or max.
+// Copies a word at a time where src and dst are both aligned.
 // Return 0 on success, -1 on error.
 int
 copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 {
-  uint64 n, va0, pa0;
-  int got_null = 0;
+  uint64 n, va0, pa0, w;
+  char *p;
 
-  while(got_null == 0 && max > 0){
+  while(max > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
-      return -1;
+    // as in ucopy(), no preemption between lookup and copy.
+    push_off();
+    if((pa0 = uaddr(pagetable, va0, 0)) == 0){
+      pop_off();
+      if(vmfault(pagetable, va0, 1) == 0)
+        return -1;
+      continue;
+    }
     n = PGSIZE - (srcva - va0);
     if(n > max)
       n = max;
+    p = (char *) (pa0 + (srcva - va0));
+    max -= n;
+    srcva = va0 + PGSIZE;
 
-    char *p = (char *) (pa0 + (srcva - va0));
     while(n > 0){
-      if(*p == '\0'){
-        *dst = '\0';
-        got_null = 1;
-        break;
-      } else {
-        *dst = *p;
+      if((((uint64)p | (uint64)dst) & 7) == 0){
+        while(n >= 8){
+          w = *(uint64 *)p;
+          if(HASZERO(w))
+            break;
+          *(uint64 *)dst = w;
+          p += 8;
+          dst += 8;
+          n -= 8;
+        }
+        if(n == 0)
+          break;
+      }
+      if((*dst = *p) == '\0'){
+        pop_off();
+        return 0;
       }
-      --n;
-      --max;
       p++;
       dst++;
+      n--;
     }
-
-    srcva = va0 + PGSIZE;
-  }
-  if(got_null){
-    return 0;
-  } else {
-    return -1;
+    pop_off();
   }
+  return -1;
 }
 
 // allocate and map user memory if process is referencing a page
-// that was lazily allocated in sys_sbrk().
+// that was lazily allocated in sys_sbrk() or that exec() left in
+// the executable, read back a page that was paged out, or copy a
+// copy-on-write page that the process writes to.
 // returns 0 if va is invalid or already mapped, or if
 // out of physical memory, and physical address if successful.
 uint64
 vmfault(pagetable_t pagetable, uint64 va, int read)
 {
   uint64 mem;
+  pte_t *pte, old;
   struct proc *p = myproc();
+  struct vma *v = vmafind(p, va);
 
-  if (va >= p->sz)
+  if (va >= p->sz && v == 0)
     return 0;
   va = PGROUNDDOWN(va);
-  if(ismapped(pagetable, va)) {
+  // read the PTE once: reclaim() may turn a present page into a
+  // swap entry at any time (but never an empty PTE into one).
+  pte = walk(pagetable, va, 0);
+  old = pte ? *pte : 0;
+  if(old & PTE_SWAP)
+    return swapin(pagetable, va);
+  if(old & PTE_V) {
+    if(!read)
+      return cowcopy(pagetable, va);
     return 0;
   }
-  mem = (uint64) kalloc();
+  if(v != 0)
+    return vmafault(pagetable, v, va);
+  mem = (uint64) kallocuser(1);
   if(mem == 0)
     return 0;
-  memset((void *) mem, 0, PGSIZE);
   if (mappages(p->pagetable, va, PGSIZE, mem, PTE_W|PTE_U|PTE_R) != 0) {
     kfree((void *)mem);
     return 0;
@@ -472,6 +784,63 @@ vmfault(pagetable_t pagetable, uint64 va, int read)
   return mem;
 }
 
+// make the copy-on-write user page at va writable, copying
+// it first unless this page table holds the only reference.
+// returns the page's physical address, or 0 if va is not
+// a copy-on-write user page or out of physical memory.
+// allocating the copy may sleep to page memory out, and the
+// other sharers may exit or the page be paged out meanwhile,
+// so look at the PTE again afterwards, with interrupts off
+// until the PTE is updated.
+uint64
+cowcopy(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  uint64 pa;
+  char *mem = 0;
+
+  if(va >= MAXVA)
+    return 0;
+  for(;;){
+    push_off();
+    pte = walk(pagetable, va, 0);
+    if(pte && (*pte & PTE_SWAP)){
+      // paged out since the caller looked: swapin() gives this
+      // process its own, writable, copy.
+      pop_off();
+      if(mem)
+        kfree(mem);
+      return swapin(pagetable, va);
+    }
+    if(pte == 0 || (*pte & (PTE_V|PTE_U|PTE_COW)) != (PTE_V|PTE_U|PTE_COW)){
+      pop_off();
+      if(mem)
+        kfree(mem);
+      return 0;
+    }
+    pa = PTE2PA(*pte);
+    if(mem || krefs((void*)pa) == 1)
+      break;
+    pop_off();
+    if((mem = kallocuser(0)) == 0)
+      return 0;
+  }
+
+  if(krefs((void*)pa) > 1){
+    memmove(mem, (char*)pa, PGSIZE);
+    *pte = PA2PTE(mem) | PTE_FLAGS(*pte);
+    kfree((void*)pa);
+    pa = (uint64)mem;
+    mem = 0;
+  }
+  *pte = (*pte & ~PTE_COW) | PTE_W;
+  sfence_vma();
+  pop_off();
+  if(mem)
+    kfree(mem);
+  return pa;
+}
+
 int
 ismapped(pagetable_t pagetable, uint64 va)
 {
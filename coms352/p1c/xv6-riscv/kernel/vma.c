@@ -0,0 +1,513 @@
+// File-backed and zero-filled regions of user memory.
+//
+// exec() does not read a program into memory. It records each
+// loadable segment as a struct vma in the process, and vmfault()
+// reads a page in from the file the first time it is touched.
+// mmap() adds regions the same way, above the heap.
+//
+// Read-only pages (program text) are kept in a small cache keyed
+// by (dev, inum, offset, length) and shared by every process that
+// maps them, so a program's text is read from disk once even when
+// it runs over and over. Writing to or truncating a file drops
+// its cached pages.
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "riscv.h"
+#include "proc.h"
+#include "defs.h"
+#include "fs.h"
+#include "file.h"
+#include "fcntl.h"
+#include "memlayout.h"
+#include "memstat.h"
+
+#define NTEXT     256   // text pages cached
+#define NTEXTHASH 64
+
+struct textpage {
+  uint dev;
+  uint inum;
+  uint off;               // file offset of the page
+  uint len;               // bytes of the page read from the file
+  uint64 pa;              // 0 if the slot is free
+  struct textpage *next;  // hash chain
+};
+
+struct {
+  struct spinlock lock;
+  struct textpage page[NTEXT];
+  struct textpage *hash[NTEXTHASH];
+  int ninode[NTEXTHASH];  // cached pages by hash of (dev, inum)
+  int hand;               // next slot to consider evicting
+  uint64 nfault;          // pages read in by vmafault()
+  uint64 nhit;            // text faults served from the cache
+} text;
+
+void
+vmainit(void)
+{
+  initlock(&text.lock, "text");
+}
+
+static struct textpage **
+texthash(uint dev, uint inum, uint off)
+{
+  return &text.hash[(dev * 31 + inum * 17 + off / PGSIZE) % NTEXTHASH];
+}
+
+static int *
+textcount(uint dev, uint inum)
+{
+  return &text.ninode[(dev * 31 + inum) % NTEXTHASH];
+}
+
+// Might the cache hold pages of this file? For iget(), which
+// sets ip->text from it when a file comes back into memory.
+int
+textcached(uint dev, uint inum)
+{
+  return __atomic_load_n(textcount(dev, inum), __ATOMIC_RELAXED) > 0;
+}
+
+static void
+textunlink(struct textpage *t)
+{
+  struct textpage **pp;
+
+  for(pp = texthash(t->dev, t->inum, t->off); *pp != t; pp = &(*pp)->next)
+    ;
+  *pp = t->next;
+  (*textcount(t->dev, t->inum))--;
+  kfree((void*)t->pa);
+  t->pa = 0;
+}
+
+// Find the cached page holding len bytes at offset off of ip.
+// Returns it with a reference for the caller, or 0.
+static uint64
+textget(struct inode *ip, uint off, uint len)
+{
+  struct textpage *t;
+  uint64 pa = 0;
+
+  acquire(&text.lock);
+  for(t = *texthash(ip->dev, ip->inum, off); t; t = t->next){
+    if(t->dev == ip->dev && t->inum == ip->inum && t->off == off && t->len == len){
+      kdup((void*)t->pa);
+      pa = t->pa;
+      text.nhit++;
+      break;
+    }
+  }
+  release(&text.lock);
+  return pa;
+}
+
+// Cache page pa, just read from offset off of ip, unless another
+// process cached the same page first. Returns the page to map,
+// which has the caller's reference. Caller holds ip->lock.
+static uint64
+textput(struct inode *ip, uint off, uint len, uint64 pa)
+{
+  struct textpage *t, **h;
+  int i;
+
+  acquire(&text.lock);
+  h = texthash(ip->dev, ip->inum, off);
+  for(t = *h; t; t = t->next){
+    if(t->dev == ip->dev && t->inum == ip->inum && t->off == off && t->len == len){
+      kfree((void*)pa);
+      kdup((void*)t->pa);
+      release(&text.lock);
+      return t->pa;
+    }
+  }
+
+  // find a free slot, or one whose page only the cache uses.
+  for(i = 0; i < NTEXT; i++){
+    t = &text.page[text.hand];
+    text.hand = (text.hand + 1) % NTEXT;
+    if(t->pa == 0)
+      break;
+    if(krefs((void*)t->pa) == 1){
+      textunlink(t);
+      break;
+    }
+  }
+  if(i < NTEXT){
+    t->dev = ip->dev;
+    t->inum = ip->inum;
+    t->off = off;
+    t->len = len;
+    t->pa = pa;
+    (*textcount(ip->dev, ip->inum))++;
+    kdup((void*)pa);
+    t->next = *h;
+    *h = t;
+    ip->text = 1;
+  }
+  release(&text.lock);
+  return pa;
+}
+
+// Drop the cached pages of ip, whose contents are changing.
+// Processes that map them keep their copies. Caller holds
+// ip->lock.
+void
+textinval(struct inode *ip)
+{
+  struct textpage *t;
+
+  if(ip->text == 0)
+    return;
+  acquire(&text.lock);
+  for(t = text.page; t < &text.page[NTEXT]; t++){
+    if(t->pa && t->dev == ip->dev && t->inum == ip->inum)
+      textunlink(t);
+  }
+  release(&text.lock);
+  ip->text = 0;
+}
+
+// Record a region of memory backed by ip, or zero-filled if ip
+// is 0, in vma[]. Takes a reference to ip.
+// Returns 0 on success, -1 if vma[] is full.
+int
+vmaadd(struct vma *vma, uint64 start, uint64 end, int perm, int flags,
+       struct inode *ip, uint off, uint filesz)
+{
+  struct vma *v;
+
+  for(v = vma; v < &vma[NVMA]; v++){
+    if(v->end == 0){
+      v->start = start;
+      v->end = end;
+      v->perm = perm;
+      v->flags = flags;
+      v->ip = ip ? idup(ip) : 0;
+      v->off = off;
+      v->filesz = filesz;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+// The region of p's memory containing va, or 0.
+struct vma *
+vmafind(struct proc *p, uint64 va)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->end && va >= v->start && va < v->end)
+      return v;
+  }
+  return 0;
+}
+
+// Does any region of p's memory overlap [start, end)?
+// sbrk() uses this to keep the heap out of mmap() regions.
+int
+vmaoverlap(struct proc *p, uint64 start, uint64 end)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->end && start < v->end && end > v->start)
+      return 1;
+  }
+  return 0;
+}
+
+// Write the dirty pages of [start, end) in shared file region v
+// back to the file, one log transaction per page. Only the bytes
+// that were in the file when it was mapped are written.
+static void
+vmawriteback(pagetable_t pagetable, struct vma *v, uint64 start, uint64 end)
+{
+  uint64 va, off;
+  uint n;
+  pte_t *pte;
+
+  if((v->flags & MAP_SHARED) == 0 || v->ip == 0 || (v->perm & PTE_W) == 0)
+    return;
+  for(va = start; va < end; va += PGSIZE){
+    off = va - v->start;
+    if(off >= v->filesz)
+      break;
+    pte = walk(pagetable, va, 0);
+    if(pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_D) == 0)
+      continue;
+    n = v->filesz - off < PGSIZE ? v->filesz - off : PGSIZE;
+    begin_op();
+    ilock(v->ip);
+    writei(v->ip, 0, PTE2PA(*pte), v->off + off, n);
+    iunlock(v->ip);
+    end_op();
+  }
+}
+
+// Unmap [start, end) of region v, writing shared pages back.
+// Caller adjusts or frees v.
+static void
+vmaunmap(pagetable_t pagetable, struct vma *v, uint64 start, uint64 end)
+{
+  vmawriteback(pagetable, v, start, end);
+  uvmunmap(pagetable, start, (end - start) / PGSIZE, 1);
+}
+
+// Forget the regions in vma[] and release their files. If
+// pagetable is not 0, first unmap them from it, writing shared
+// pages back to their files.
+void
+vmadrop(pagetable_t pagetable, struct vma *vma)
+{
+  struct vma *v;
+
+  for(v = vma; v < &vma[NVMA]; v++){
+    if(v->end && pagetable)
+      vmaunmap(pagetable, v, v->start, v->end);
+  }
+  begin_op();
+  for(v = vma; v < &vma[NVMA]; v++){
+    if(v->ip)
+      iput(v->ip);
+    memset(v, 0, sizeof(*v));
+  }
+  end_op();
+}
+
+// Fault in every page of p's shared mmap() regions, so that a
+// child of fork() maps the same pages. Returns 0, or -1 if out
+// of memory. Called before fork() takes any locks.
+int
+vmafill(struct proc *p)
+{
+  struct vma *v;
+  uint64 va;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->end == 0 || (v->flags & MAP_SHARED) == 0)
+      continue;
+    for(va = v->start; va < v->end; va += PGSIZE){
+      if(walkaddr(p->pagetable, va) == 0 &&
+         vmafault(p->pagetable, v, va) == 0)
+        return -1;
+    }
+  }
+  return 0;
+}
+
+// Give a child of fork() the parent's regions. The program's
+// segments lie below p->sz and were copied with the rest of its
+// memory; map the pages of the mmap() regions above it too,
+// copy-on-write unless shared. Returns 0 on success, -1 if out
+// of memory.
+int
+vmadup(struct proc *np, struct proc *p)
+{
+  struct vma *v;
+  int i;
+
+  for(i = 0; i < NVMA; i++){
+    v = &p->vma[i];
+    if(v->end == 0 || v->start < p->sz)
+      continue;
+    if(uvmdup(p->pagetable, np->pagetable, v->start, v->end,
+              (v->flags & MAP_SHARED) == 0) < 0){
+      while(--i >= 0){
+        v = &p->vma[i];
+        if(v->end && v->start >= p->sz)
+          uvmunmap(np->pagetable, v->start, (v->end - v->start) / PGSIZE, 1);
+      }
+      return -1;
+    }
+  }
+  for(i = 0; i < NVMA; i++){
+    np->vma[i] = p->vma[i];
+    if(p->vma[i].ip)
+      idup(p->vma[i].ip);
+  }
+  return 0;
+}
+
+// Map len bytes of ip starting at off (or zeroes, if ip is 0)
+// into p's memory, at addr if that range is free and above the
+// heap, otherwise at the highest free range below MMAPTOP.
+// filesz is how many of the bytes are in the file.
+// Returns the address, or -1.
+uint64
+vmamap(struct proc *p, uint64 addr, uint64 len, int perm, int flags,
+       struct inode *ip, uint off, uint filesz)
+{
+  uint64 start, top;
+  struct vma *v;
+
+  len = PGROUNDUP(len);
+  start = addr;
+  if(addr % PGSIZE != 0 || addr < PGROUNDUP(p->sz) || addr + len > MMAPTOP ||
+     addr + len < addr || vmaoverlap(p, addr, addr + len)){
+    // move down past each region in the way.
+    top = MMAPTOP;
+    for(;;){
+      if(top < len || top - len < PGROUNDUP(p->sz))
+        return -1;
+      start = top - len;
+      for(v = p->vma; v < &p->vma[NVMA]; v++){
+        if(v->end && start < v->end && top > v->start)
+          break;
+      }
+      if(v == &p->vma[NVMA])
+        break;
+      top = v->start;
+    }
+  }
+  if(vmaadd(p->vma, start, start + len, perm, flags, ip, off, filesz) < 0)
+    return -1;
+  return start;
+}
+
+// Remove [addr, addr+len) from p's mmap() regions, writing shared
+// pages back to their files. A region can lose its start, its end,
+// or the middle, which splits it in two.
+// Returns 0 on success, -1 on a bad range or if a split finds no
+// free slot.
+int
+vmaremove(struct proc *p, uint64 addr, uint64 len)
+{
+  struct vma *v, *w;
+  uint64 end, s, e, d;
+
+  end = addr + PGROUNDUP(len);
+  if(addr % PGSIZE != 0 || len == 0 || end < addr || addr < p->sz || end > MMAPTOP)
+    return -1;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->end == 0 || addr >= v->end || end <= v->start)
+      continue;
+    s = addr > v->start ? addr : v->start;
+    e = end < v->end ? end : v->end;
+
+    if(s > v->start && e < v->end){
+      // the middle: the part after e needs a slot of its own.
+      for(w = p->vma; w < &p->vma[NVMA] && w->end; w++)
+        ;
+      if(w == &p->vma[NVMA])
+        return -1;
+      vmaunmap(p->pagetable, v, s, e);
+      *w = *v;
+      d = e - v->start;
+      w->start = e;
+      w->off += d;
+      w->filesz = w->filesz > d ? w->filesz - d : 0;
+      if(w->ip)
+        idup(w->ip);
+      if(v->filesz > s - v->start)
+        v->filesz = s - v->start;
+      v->end = s;
+      continue;
+    }
+
+    vmaunmap(p->pagetable, v, s, e);
+    if(s == v->start && e == v->end){
+      if(v->ip){
+        begin_op();
+        iput(v->ip);
+        end_op();
+      }
+      memset(v, 0, sizeof(*v));
+    } else if(s == v->start){
+      d = e - v->start;
+      v->start = e;
+      v->off += d;
+      v->filesz = v->filesz > d ? v->filesz - d : 0;
+    } else {
+      if(v->filesz > s - v->start)
+        v->filesz = s - v->start;
+      v->end = s;
+    }
+  }
+  return 0;
+}
+
+// Map the page at va, in region v, reading it in from the file.
+// Returns the physical address, or 0 on error or if the caller
+// holds a spin-lock and so cannot wait for the disk.
+uint64
+vmafault(pagetable_t pagetable, struct vma *v, uint64 va)
+{
+  uint64 off = va - v->start, pa = 0;
+  uint n = 0;
+  int perm = v->perm | PTE_R | PTE_U;
+  int locked;
+  char *mem;
+
+  push_off();
+  locked = mycpu()->noff > 1;
+  pop_off();
+  if(locked)
+    return 0;
+
+  if(off < v->filesz){
+    n = v->filesz - off < PGSIZE ? v->filesz - off : PGSIZE;
+    if((v->perm & PTE_W) == 0)
+      pa = textget(v->ip, v->off + off, n);
+  }
+
+  if(pa == 0 && n > 0 && myproc()->iolock && myproc()->iolock != v->ip){
+    // fileread() or filewrite() is copying to or from here with
+    // another inode locked. locking v->ip too could deadlock with
+    // a process doing the reverse, so leave the page for them to
+    // fault in once they have unlocked theirs.
+    myproc()->iofault = va;
+    return 0;
+  }
+
+  if(pa == 0){
+    if((mem = kallocuser(1)) == 0)
+      return 0;
+    pa = (uint64)mem;
+    if(n > 0){
+      // the faulting process may be reading this very file.
+      locked = holdingsleep(&v->ip->lock);
+      if(!locked)
+        ilock(v->ip);
+      if(readi(v->ip, 0, pa, v->off + off, n) != n){
+        if(!locked)
+          iunlock(v->ip);
+        kfree(mem);
+        return 0;
+      }
+      if((v->perm & PTE_W) == 0)
+        pa = textput(v->ip, v->off + off, n, pa);
+      if(!locked)
+        iunlock(v->ip);
+      __atomic_add_fetch(&text.nfault, 1, __ATOMIC_RELAXED);
+    }
+  }
+
+  if(mappages(pagetable, va, PGSIZE, pa, perm) != 0){
+    kfree((void*)pa);
+    return 0;
+  }
+  return pa;
+}
+
+// Fill in the demand paging statistics for memstats().
+void
+vmastats(struct memstats *st)
+{
+  struct textpage *t;
+
+  acquire(&text.lock);
+  st->filefaults = text.nfault;
+  st->texthits = text.nhit;
+  for(t = text.page; t < &text.page[NTEXT]; t++)
+    if(t->pa)
+      st->textpages++;
+  release(&text.lock);
+}
@@ -0,0 +1,41 @@
+//
+// The zero device: reads return zero bytes, writes are
+// discarded. copybench reads it to time copyout().
+//
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "fs.h"
+#include "file.h"
+
+static char zeros[PGSIZE];
+
+int
+zeroread(int user_dst, uint64 dst, int n)
+{
+  int i, m;
+
+  for(i = 0; i < n; i += m){
+    m = n - i < PGSIZE ? n - i : PGSIZE;
+    if(either_copyout(user_dst, dst + i, zeros, m) == -1)
+      return i > 0 ? i : -1;
+  }
+  return n;
+}
+
+int
+zerowrite(int user_src, uint64 src, int n)
+{
+  return n;
+}
+
+void
+zeroinit(void)
+{
+  devsw[ZERO].read = zeroread;
+  devsw[ZERO].write = zerowrite;
+}
@@ -7,6 +7,7 @@
 # ./test-xv6.py -q usertests (runs the quick tests of usertests)
 # ./test-xv6.py crash  (runs the crash tests)
 # ./test-xv6.py log (runs the log crash test)
+# ./test-xv6.py schedbench (runs schedbench under every scheduler, writes schedbench.csv)
 
 import argparse, os, inspect, re, signal, subprocess, sys, time
 from subprocess import run
@@ -14,6 +15,8 @@ from subprocess import run
 parser = argparse.ArgumentParser()
 parser.add_argument('testrex', help="test name or regular expression")
 parser.add_argument("-q", action='store_true', help="usertests quick")
+parser.add_argument("--bench", default="cpu=4 io=2 inter=1 fork=1",
+                    help="schedbench workload arguments")
 args = parser.parse_args()
 
 class QEMU(object):
@@ -199,6 +202,26 @@ def test_usertests(test=""):
     q.monitor('^ALL TESTS PASSED', progress='test', timeout=timeout)
     q.stop()
 
+def test_schedbench():
+    print("Run schedbench under each scheduler")
+    policies = ["rr", "rrsp", "mlfq", "cfs"]
+    q = QEMU(True)
+    time.sleep(2)
+    for p in policies:
+        q.cmd("schedbench policy=%s %s\n" % (p, args.bench))
+        q.monitor('^summary,%s,' % p, progress='^job,', timeout=600)
+    q.stop()
+    rows = []
+    for line in q.lines():
+        if re.match(r'^(job|summary),', line) and line not in rows:
+            rows.append(line)
+    with open("schedbench.csv", "w") as f:
+        f.write("\n".join(rows) + "\n")
+    print("wrote schedbench.csv")
+    for line in rows:
+        if line.startswith("summary,"):
+            print(line)
+
 def main():
     print(args)
     rex = r'%s' % args.testrex
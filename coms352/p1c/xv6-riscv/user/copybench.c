@@ -0,0 +1,101 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/pstat.h"
+#include "kernel/fcntl.h"
+#include "kernel/spinlock.h"
+#include "kernel/sleeplock.h"
+#include "kernel/fs.h"
+#include "kernel/file.h"
+#include "user/user.h"
+
+#define CHUNK  (64 * 1024)
+#define ROUNDS 200
+
+static char buf[CHUNK];
+
+// Lifetime of this process so far, in cycles
+uint64 lifetime() {
+  struct procstats st;
+  getprocstats(getpid(), &st);
+  return st.runtime + st.waittime + st.sleeptime;
+}
+
+void report(char *what, int rounds, uint64 cycles) {
+  uint64 us = cycles / (TIMEFREQ / 1000000);
+  printf("copybench: %s: %d x 64 KiB in %lu us", what, rounds, us);
+  if (us > 0)
+    printf(", %lu MB/s", (uint64)rounds * CHUNK / us);
+  printf("\n");
+}
+
+/*
+ * copybench.c
+ * Times 64 KiB read() and write() calls, whose cost is mostly the
+ * kernel's copyout() and copyin():
+ *   zero: read() from the zero device, one copyout() per page
+ *   pipe: write() into a pipe that a child drains with read(),
+ *         copyin() and copyout() in 128-byte pieces
+ * Run it before and after a change to the copy functions.
+ *
+ * usage: copybench [rounds]
+ */
+int
+main(int argc, char *argv[])
+{
+  int rounds = ROUNDS;
+  int fd, fds[2], i, n, pid;
+  uint64 start;
+
+  if (argc > 1)
+    rounds = atoi(argv[1]);
+
+  if ((fd = open("zero", O_RDONLY)) < 0) {
+    mknod("zero", ZERO, 0);
+    fd = open("zero", O_RDONLY);
+  }
+  if (fd < 0) {
+    fprintf(2, "copybench: cannot open zero\n");
+    exit(1);
+  }
+
+  // The first read faults in buf's pages; don't time it.
+  read(fd, buf, CHUNK);
+  start = lifetime();
+  for (i = 0; i < rounds; i++) {
+    if (read(fd, buf, CHUNK) != CHUNK) {
+      fprintf(2, "copybench: short read\n");
+      exit(1);
+    }
+  }
+  report("zero", rounds, lifetime() - start);
+  close(fd);
+
+  if (pipe(fds) < 0) {
+    fprintf(2, "copybench: pipe failed\n");
+    exit(1);
+  }
+  pid = fork();
+  if (pid < 0) {
+    fprintf(2, "copybench: fork failed\n");
+    exit(1);
+  }
+  if (pid == 0) {
+    close(fds[1]);
+    while ((n = read(fds[0], buf, CHUNK)) > 0)
+      ;
+    exit(0);
+  }
+  close(fds[0]);
+  start = lifetime();
+  for (i = 0; i < rounds; i++) {
+    if (write(fds[1], buf, CHUNK) != CHUNK) {
+      fprintf(2, "copybench: short write\n");
+      exit(1);
+    }
+  }
+  close(fds[1]);
+  wait(0);
+  report("pipe", rounds, lifetime() - start);
+  exit(0);
+}
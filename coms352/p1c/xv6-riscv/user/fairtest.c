@@ -10,14 +10,91 @@ void cpu_bound_loop() {
   }
 }
 
+// Length of the share measurement, in ticks
+#define SHARE_TICKS 50
+
+// Count batches of loop iterations until tick end
+long count_until(int end) {
+  long n = 0;
+  int i;
+  while (uptime() < end) {
+    for (i = 0; i < 10000; i++) {
+      asm volatile("nop");
+    }
+    n++;
+  }
+  return n;
+}
+
+// Share mode: every child counts loop iterations over the same
+// window of ticks, and the parent reports each child's part of the
+// total next to the share a fair scheduler would give it.
+void share_test(int n) {
+  int fds[2];
+  int i;
+  long counts[4], total = 0;
+  struct { int idx; long count; } r;
+
+  printf("Starting share test (%d CPU-bound processes, %d ticks)...\n", n, SHARE_TICKS);
+  if (pipe(fds) < 0) {
+    printf("Pipe failed!\n");
+    exit(1);
+  }
+
+  int end = uptime() + SHARE_TICKS;
+  for (i = 0; i < n; i++) {
+    int pid = fork();
+    if (pid < 0) {
+      printf("Fork failed!\n");
+      exit(1);
+    } else if (pid == 0) {
+      r.idx = i;
+      r.count = count_until(end);
+      write(fds[1], &r, sizeof(r));
+      exit(0);
+    }
+  }
+  close(fds[1]);
+
+  for (i = 0; i < n; i++) {
+    if (read(fds[0], &r, sizeof(r)) != sizeof(r)) {
+      printf("Read failed!\n");
+      exit(1);
+    }
+    counts[r.idx] = r.count;
+    total += r.count;
+  }
+  for (i = 0; i < n; i++) {
+    wait(0);
+  }
+  if (total == 0) {
+    total = 1;
+  }
+
+  // Shares are printed in tenths of a percent
+  for (i = 0; i < n; i++) {
+    int got = counts[i] * 1000 / total;
+    int want = 1000 / n;
+    printf("Process %d: %d.%d%% of CPU, expected %d.%d%%\n",
+           i + 1, got / 10, got % 10, want / 10, want % 10);
+  }
+  printf("Share test complete.\n");
+}
+
 /*
  * fairtest.c
  * Tests the fairness of the schedulers.
  * Creates 4 identical CPU-bound child processes.
+ * With -s, reports the CPU share each child achieved instead.
  */
 int
 main(int argc, char *argv[])
 {
+  if (argc > 1 && strcmp(argv[1], "-s") == 0) {
+    share_test(4);
+    exit(0);
+  }
+
   printf("Starting fairness test (4 CPU-bound processes)...\n");
 
   startLogging();
@@ -0,0 +1,67 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NWORKERS 8
+#define NFORKS   200
+
+// A little CPU work per child, so that extra CPUs have something to do.
+void short_loop() {
+  int i;
+  for (i = 0; i < 200000; i++) {
+    asm volatile("nop");
+  }
+}
+
+/*
+ * forkbench.c
+ * Fork-heavy workload for comparing single- and multi-CPU scheduling.
+ * Starts NWORKERS workers, each of which forks, runs and reaps
+ * NFORKS short-lived children one after another. Prints the
+ * wall-clock time in ticks; run it under "make qemu CPUS=1" and
+ * "make qemu CPUS=8" to compare.
+ *
+ * usage: forkbench [workers] [forks]
+ */
+int
+main(int argc, char *argv[])
+{
+  int nworkers = NWORKERS;
+  int nforks = NFORKS;
+  int i, j, pid, start;
+
+  if (argc > 1)
+    nworkers = atoi(argv[1]);
+  if (argc > 2)
+    nforks = atoi(argv[2]);
+
+  start = uptime();
+  for (i = 0; i < nworkers; i++) {
+    pid = fork();
+    if (pid < 0) {
+      printf("Fork failed!\n");
+      exit(1);
+    } else if (pid == 0) {
+      for (j = 0; j < nforks; j++) {
+        pid = fork();
+        if (pid < 0) {
+          printf("Fork failed!\n");
+          exit(1);
+        } else if (pid == 0) {
+          short_loop();
+          exit(0);
+        }
+        wait(0);
+      }
+      exit(0);
+    }
+  }
+
+  for (i = 0; i < nworkers; i++) {
+    wait(0);
+  }
+
+  printf("forkbench: %d workers x %d forks in %d ticks\n",
+         nworkers, nforks, uptime() - start);
+  exit(0);
+}
@@ -0,0 +1,60 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fs.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+/*
+ * free.c
+ * Prints the physical page allocator's state from memstats():
+ * free pages, where they are (buddy pool, per-CPU caches, zeroed
+ * pages), and the buddy pool's free blocks of each order. For each
+ * order k, "unusable" is the percentage of the free pages in the
+ * buddy pool that sit in blocks smaller than 2^k pages, and so
+ * cannot serve a kallocpages(k) request: 0 means no fragmentation.
+ * Then prints the text page cache, swap, buffer cache and disk
+ * counters and each slab cache's object size and usage.
+ *
+ * usage: free
+ */
+int
+main(int argc, char *argv[])
+{
+  struct memstats st;
+  uint64 pool = 0, small = 0;
+  int k;
+
+  if (memstats(&st) < 0) {
+    fprintf(2, "free: memstats failed\n");
+    exit(1);
+  }
+
+  for (k = 0; k < NORDER; k++)
+    pool += st.nfree[k] << k;
+
+  printf("free pages: %lu (%lu KB)\n", st.freepages, st.freepages * 4);
+  printf("  buddy pool %lu, per-CPU caches %lu, zeroed %lu\n",
+         pool, st.cached, st.zeroed);
+  printf("order  pages  blocks  unusable\n");
+  for (k = 0; k < NORDER; k++) {
+    printf("%d      %d\t   %lu\t   %lu%%\n", k, 1 << k, st.nfree[k],
+           pool > 0 ? small * 100 / pool : 0);
+    small += st.nfree[k] << k;
+  }
+
+  printf("text pages cached %lu, file faults %lu, text hits %lu\n",
+         st.textpages, st.filefaults, st.texthits);
+  printf("swap used %lu of %lu pages, paged in %lu, out %lu, dropped %lu\n",
+         st.swapused, st.swapsize, st.swapins, st.swapouts, st.swapdrops);
+  printf("buffer cache %lu blocks (%lu KB), hits %lu, misses %lu, read ahead %lu\n",
+         st.nbuf, st.nbuf * BSIZE / 1024, st.bufhits, st.bufmisses, st.bufahead);
+  printf("disk requests %lu, blocks %lu, interrupts %lu\n",
+         st.diskreqs, st.diskblocks, st.diskintrs);
+
+  printf("cache    size  perslab  pages  inuse\n");
+  for (k = 0; k < st.nslab; k++) {
+    printf("%s\t %d\t %d\t  %lu\t %lu\n", st.slab[k].name, st.slab[k].size,
+           st.slab[k].perslab, st.slab[k].pages, st.slab[k].inuse);
+  }
+  exit(0);
+}
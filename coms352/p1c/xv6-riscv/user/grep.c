@@ -8,29 +8,50 @@
 char buf[1024];
 int match(char*, char*);
 
+// Print the lines of the n bytes at p, which end in a 0 byte,
+// that match pattern. Returns how many bytes follow the last
+// newline.
+int
+greplines(char *pattern, char *p, int n)
+{
+  char *q, *end = p + n;
+
+  while((q = strchr(p, '\n')) != 0){
+    *q = 0;
+    if(match(pattern, p)){
+      *q = '\n';
+      write(1, p, q+1 - p);
+    }
+    *q = '\n';
+    p = q+1;
+  }
+  return end - p;
+}
+
 void
 grep(char *pattern, int fd)
 {
   int n, m;
-  char *p, *q;
+  char *p;
+  struct stat st;
+
+  // a regular file: work on a private mapping of it, one byte
+  // longer than the file so that it ends in a 0 byte, instead
+  // of copying it through buf.
+  if(fstat(fd, &st) == 0 && st.type == T_FILE && st.size > 0 &&
+     (p = mmap(0, st.size + 1, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0)) != MAP_FAILED){
+    greplines(pattern, p, st.size);
+    munmap(p, st.size + 1);
+    return;
+  }
 
   m = 0;
   while((n = read(fd, buf+m, sizeof(buf)-m-1)) > 0){
     m += n;
     buf[m] = '\0';
-    p = buf;
-    while((q = strchr(p, '\n')) != 0){
-      *q = 0;
-      if(match(pattern, p)){
-        *q = '\n';
-        write(1, p, q+1 - p);
-      }
-      p = q+1;
-    }
-    if(m > 0){
-      m -= p - buf;
-      memmove(buf, p, m);
-    }
+    n = greplines(pattern, buf, m);
+    memmove(buf, buf + m - n, n);
+    m = n;
   }
 }
 
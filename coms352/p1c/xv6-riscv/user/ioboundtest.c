@@ -24,11 +24,14 @@ void io_bound_loop() {
  * Creates 4 children:
  * 2 CPU-bound (long loop)
  * 2 I/O-bound (sleep loop)
+ * Each child prints its turnaround time in ticks when it finishes,
+ * so MLFQ settings (see mlfqtune) can be compared.
  */
 int
 main(int argc, char *argv[])
 {
   printf("Starting I/O vs CPU test (2 CPU-bound, 2 I/O-bound)...\n");
+  int start = uptime();
 
   for (int i = 0; i < 4; i++) {
     int pid = fork();
@@ -41,12 +44,14 @@ main(int argc, char *argv[])
         // CPU-bound processes
         printf("CPU-bound process (PID: %d) starting CPU loop.\n", getpid());
         cpu_bound_loop();
-        printf("CPU-bound process (PID: %d) finished.\n", getpid());
+        printf("CPU-bound process (PID: %d) finished, turnaround %d ticks.\n",
+               getpid(), uptime() - start);
       } else {
         // I/O-bound processes
         printf("I/O-bound process (PID: %d) starting I/O loop.\n", getpid());
         io_bound_loop();
-        printf("I/O-bound process (PID: %d) finished.\n", getpid());
+        printf("I/O-bound process (PID: %d) finished, turnaround %d ticks.\n",
+               getpid(), uptime() - start);
       }
       exit(0);
     }
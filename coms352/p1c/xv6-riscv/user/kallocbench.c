@@ -0,0 +1,83 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+#define NWORKERS 4
+#define ROUNDS   500
+#define NPAGES   16
+
+// Grow and shrink the heap: every round allocates and frees
+// npages pages (plus page-table pages) through kalloc()/kfree().
+void worker(int rounds, int npages) {
+  for (int i = 0; i < rounds; i++) {
+    if (sbrk(npages * PGSIZE) == (char*)-1) {
+      printf("kallocbench: sbrk failed\n");
+      exit(1);
+    }
+    sbrk(-npages * PGSIZE);
+  }
+}
+
+/*
+ * kallocbench.c
+ * Microbenchmark for the physical page allocator.
+ * Starts nworkers processes that each grow and shrink their heap
+ * by npages pages, rounds times, so that every CPU allocates and
+ * frees pages at once. Prints the wall-clock time in ticks and the
+ * allocator's per-CPU cache statistics from memstats(): a kalloc()
+ * only takes the global lock when its CPU's cache needs a refill.
+ * Run it under "make qemu CPUS=1" and "make qemu CPUS=4" to compare.
+ *
+ * usage: kallocbench [workers] [rounds] [npages]
+ */
+int
+main(int argc, char *argv[])
+{
+  int nworkers = NWORKERS;
+  int rounds = ROUNDS;
+  int npages = NPAGES;
+  struct memstats before, after;
+  int i, pid, start, elapsed;
+  uint64 nalloc, nrefill;
+
+  if (argc > 1)
+    nworkers = atoi(argv[1]);
+  if (argc > 2)
+    rounds = atoi(argv[2]);
+  if (argc > 3)
+    npages = atoi(argv[3]);
+
+  memstats(&before);
+  start = uptime();
+  for (i = 0; i < nworkers; i++) {
+    pid = fork();
+    if (pid < 0) {
+      printf("Fork failed!\n");
+      exit(1);
+    } else if (pid == 0) {
+      worker(rounds, npages);
+      exit(0);
+    }
+  }
+  for (i = 0; i < nworkers; i++) {
+    wait(0);
+  }
+  elapsed = uptime() - start;
+  memstats(&after);
+
+  nalloc = after.nalloc - before.nalloc;
+  nrefill = after.nrefill - before.nrefill;
+  printf("kallocbench: %d workers x %d rounds x %d pages in %d ticks\n",
+         nworkers, rounds, npages, elapsed);
+  printf("kallocbench: %lu allocs, %lu refills, %lu spills, %lu steals\n",
+         nalloc, nrefill, after.nspill - before.nspill,
+         after.nsteal - before.nsteal);
+  if (nalloc > 0)
+    printf("kallocbench: %lu%% of allocs took no shared lock\n",
+           (nalloc - nrefill) * 100 / nalloc);
+  printf("kallocbench: %lu free pages, %lu in per-CPU caches\n",
+         after.freepages, after.cached);
+  exit(0);
+}
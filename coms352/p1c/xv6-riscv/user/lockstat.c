@@ -0,0 +1,67 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+struct lockstat before[NLOCKSTAT], after[NLOCKSTAT];
+
+/*
+ * lockstat.c
+ * Prints spin-lock contention from lockstats(): for each lock name,
+ * how many locks have it, how many acquire() calls there were, how
+ * many of them found the lock held, and how long they spun. With a
+ * command, runs it and prints only what happened while it ran,
+ * e.g. "lockstat logstress f1 f2 f3 f4". Names no one acquired
+ * meanwhile are left out.
+ *
+ * usage: lockstat [command [args]]
+ */
+int
+main(int argc, char *argv[])
+{
+  struct lockstat *a, *b;
+  int nbefore = 0, nafter, i, j, pid;
+
+  if (argc > 1) {
+    nbefore = lockstats(before, NLOCKSTAT);
+    pid = fork();
+    if (pid < 0) {
+      fprintf(2, "lockstat: fork failed\n");
+      exit(1);
+    }
+    if (pid == 0) {
+      exec(argv[1], argv + 1);
+      fprintf(2, "lockstat: exec %s failed\n", argv[1]);
+      exit(1);
+    }
+    wait(0);
+  }
+  if ((nafter = lockstats(after, NLOCKSTAT)) < 0) {
+    fprintf(2, "lockstat: lockstats failed\n");
+    exit(1);
+  }
+
+  printf("lock            locks  acquires  contended  spins\n");
+  for (i = 0; i < nafter; i++) {
+    a = &after[i];
+    // subtract the counts from before the command ran
+    for (j = 0; j < nbefore; j++) {
+      b = &before[j];
+      if (strcmp(a->name, b->name) == 0) {
+        a->nacquire -= b->nacquire;
+        a->ncontend -= b->ncontend;
+        a->nspin -= b->nspin;
+        break;
+      }
+    }
+    if (a->nacquire == 0)
+      continue;
+    printf("%s", a->name);
+    for (j = strlen(a->name); j < 16; j++)
+      printf(" ");
+    printf("%d\t %lu\t   %lu\t      %lu\n", a->nlocks, a->nacquire,
+           a->ncontend, a->nspin);
+  }
+  exit(0);
+}
@@ -13,9 +13,10 @@ char buf[BUFSZ];
 int
 main(int argc, char **argv)
 {
-  int fd, n;
+  int fd, n, start;
   enum { N = 250, SZ=2000 };
   
+  start = uptime();
   for (int i = 1; i < argc; i++){
     int pid1 = fork();
     if(pid1 < 0){
@@ -44,5 +45,6 @@ main(int argc, char **argv)
     if(xstatus != 0)
       exit(xstatus);
   }
+  printf("%s: %d ticks\n", argv[0], uptime() - start);
   return 0;
 }
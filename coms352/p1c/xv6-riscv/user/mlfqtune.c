@@ -0,0 +1,69 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/mlfq.h"
+#include "user/user.h"
+
+void usage() {
+  fprintf(2, "usage: mlfqtune [q2=N] [q1=N] [q0=N] [boost=N] [adaptive=0|1] [starve=N]\n");
+  exit(1);
+}
+
+/*
+ * mlfqtune.c
+ * Reads or changes the MLFQ tunables. With no arguments, prints the
+ * settings in effect. Each name=value argument changes one setting:
+ *   q2, q1:   ticks at that level before demotion
+ *   q0:       quantum at the lowest level (kept for symmetry; Q0
+ *             never demotes)
+ *   boost:    ticks between priority boosts
+ *   adaptive: 1 to let the kernel shorten the boost period when a Q0
+ *             process starves and lengthen it under batch load
+ *   starve:   ticks a Q0 process may wait before it counts as starving
+ *
+ * usage: mlfqtune [q2=N] [q1=N] [q0=N] [boost=N] [adaptive=0|1] [starve=N]
+ */
+int
+main(int argc, char *argv[])
+{
+  struct mlfqparams mp;
+  char *arg, *val;
+  int i;
+
+  if (mlfqtune(&mp, 0) < 0) {
+    fprintf(2, "mlfqtune: cannot read tunables\n");
+    exit(1);
+  }
+
+  for (i = 1; i < argc; i++) {
+    arg = argv[i];
+    val = strchr(arg, '=');
+    if (val == 0)
+      usage();
+    *val++ = 0;
+    if (strcmp(arg, "q2") == 0) {
+      mp.quantum[2] = atoi(val);
+    } else if (strcmp(arg, "q1") == 0) {
+      mp.quantum[1] = atoi(val);
+    } else if (strcmp(arg, "q0") == 0) {
+      mp.quantum[0] = atoi(val);
+    } else if (strcmp(arg, "boost") == 0) {
+      mp.boost = atoi(val);
+    } else if (strcmp(arg, "adaptive") == 0) {
+      mp.adaptive = atoi(val);
+    } else if (strcmp(arg, "starve") == 0) {
+      mp.starve = atoi(val);
+    } else {
+      usage();
+    }
+  }
+
+  if (argc > 1 && mlfqtune(&mp, 1) < 0) {
+    fprintf(2, "mlfqtune: invalid setting\n");
+    exit(1);
+  }
+
+  printf("q2=%d q1=%d q0=%d boost=%d adaptive=%d starve=%d\n",
+         mp.quantum[2], mp.quantum[1], mp.quantum[0],
+         mp.boost, mp.adaptive, mp.starve);
+  exit(0);
+}
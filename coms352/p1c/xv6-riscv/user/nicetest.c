@@ -10,16 +10,109 @@ void cpu_bound_loop() {
   }
 }
 
+// Length of the share measurement, in ticks
+#define SHARE_TICKS 50
+
+// CFS weight for each nice value, -20 through 19 (same table as the kernel)
+static const int nice_to_weight[40] = {
+ /* -20 */ 88761, 71755, 56483, 46273, 36291,
+ /* -15 */ 29154, 23254, 18705, 14949, 11916,
+ /* -10 */  9548,  7620,  6100,  4904,  3906,
+ /*  -5 */  3121,  2501,  1991,  1586,  1277,
+ /*   0 */  1024,   820,   655,   526,   423,
+ /*   5 */   335,   272,   215,   172,   137,
+ /*  10 */   110,    87,    70,    56,    45,
+ /*  15 */    36,    29,    23,    18,    15,
+};
+
+// Count batches of loop iterations until tick end
+long count_until(int end) {
+  long n = 0;
+  int i;
+  while (uptime() < end) {
+    for (i = 0; i < 10000; i++) {
+      asm volatile("nop");
+    }
+    n++;
+  }
+  return n;
+}
+
+// Share mode: the same 2 high / 2 low priority children count loop
+// iterations over the same window of ticks, and the parent reports
+// each child's part of the total next to its expected CFS share,
+// weight / total weight.
+void share_test(void) {
+  int nices[4] = { -15, -15, 15, 15 };
+  int fds[2];
+  int i;
+  long counts[4], total = 0, weights = 0;
+  struct { int idx; long count; } r;
+
+  printf("Starting share test (2 high-pri, 2 low-pri, %d ticks)...\n", SHARE_TICKS);
+  if (pipe(fds) < 0) {
+    printf("Pipe failed!\n");
+    exit(1);
+  }
+
+  int end = uptime() + SHARE_TICKS;
+  for (i = 0; i < 4; i++) {
+    weights += nice_to_weight[nices[i] + 20];
+    int pid = fork();
+    if (pid < 0) {
+      printf("Fork failed!\n");
+      exit(1);
+    } else if (pid == 0) {
+      nice(getpid(), nices[i]);
+      r.idx = i;
+      r.count = count_until(end);
+      write(fds[1], &r, sizeof(r));
+      exit(0);
+    }
+  }
+  close(fds[1]);
+
+  for (i = 0; i < 4; i++) {
+    if (read(fds[0], &r, sizeof(r)) != sizeof(r)) {
+      printf("Read failed!\n");
+      exit(1);
+    }
+    counts[r.idx] = r.count;
+    total += r.count;
+  }
+  for (i = 0; i < 4; i++) {
+    wait(0);
+  }
+  if (total == 0) {
+    total = 1;
+  }
+
+  // Shares are printed in tenths of a percent
+  for (i = 0; i < 4; i++) {
+    int got = counts[i] * 1000 / total;
+    int want = nice_to_weight[nices[i] + 20] * 1000L / weights;
+    printf("Process %d (nice %d): %d.%d%% of CPU, expected %d.%d%%\n",
+           i + 1, nices[i], got / 10, got % 10, want / 10, want % 10);
+  }
+  printf("Share test complete.\n");
+}
+
 /*
  * nicetest.c
  * Tests priority-based scheduling.
  * Creates 4 CPU-bound children:
  * 2 with high priority (nice: -15)
  * 2 with low priority (nice: 15)
+ * With -s, reports the CPU share each child achieved instead.
  */
 int
 main(int argc, char *argv[])
 {
+  if (argc > 1 && strcmp(argv[1], "-s") == 0) {
+    share_test();
+    exit(0);
+  }
+
   printf("Starting nice test (2 high-pri, 2 low-pri)...\n");
 
   for (int i = 0; i < 4; i++) {
@@ -0,0 +1,115 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/pstat.h"
+#include "kernel/fcntl.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+#define NFILES   4
+#define FILESIZE (256 * 1024)   // MAXFILE blocks is 268 KiB
+#define READSIZE 512            // what cat reads at a time
+
+static char buf[1024];
+
+// Lifetime of this process so far, in cycles
+uint64 lifetime() {
+  struct procstats st;
+  getprocstats(getpid(), &st);
+  return st.runtime + st.waittime + st.sleeptime;
+}
+
+void name(char *s, int i) {
+  s[0] = 'r';
+  s[1] = 'b';
+  s[2] = '0' + i;
+  s[3] = 0;
+}
+
+// Read every file with a cold buffer cache, READSIZE bytes at a
+// time, and return the time it took in us.
+uint64 pass(int nfiles, struct memstats *st) {
+  char f[4];
+  int i, fd, n;
+  uint64 start;
+
+  dropcache();
+  start = lifetime();
+  for (i = 0; i < nfiles; i++) {
+    name(f, i);
+    if ((fd = open(f, O_RDONLY)) < 0) {
+      fprintf(2, "readbench: cannot open %s\n", f);
+      exit(1);
+    }
+    while ((n = read(fd, buf, READSIZE)) > 0)
+      ;
+    close(fd);
+  }
+  start = lifetime() - start;
+  memstats(st);
+  return start / (TIMEFREQ / 1000000);
+}
+
+/*
+ * readbench.c
+ * Measures sequential read throughput with and without read-ahead.
+ * Writes NFILES files of 256 KiB (1 MiB in all; one file can be no
+ * bigger than 268 KiB), then, with the buffer cache emptied by
+ * dropcache() each time, reads them all 512 bytes at a time like
+ * cat, first with read-ahead off and then on. Prints the time and
+ * throughput, and the disk requests and blocks read ahead, of each.
+ *
+ * usage: readbench [nfiles]
+ */
+int
+main(int argc, char *argv[])
+{
+  int nfiles = NFILES;
+  int old, i, j, fd;
+  char f[4];
+  struct memstats st0, st;
+  uint64 us;
+
+  if (argc > 1)
+    nfiles = atoi(argv[1]);
+  if (nfiles < 1 || nfiles > 10) {
+    fprintf(2, "usage: readbench [nfiles]\n");
+    exit(1);
+  }
+
+  memset(buf, 'x', sizeof(buf));
+  for (i = 0; i < nfiles; i++) {
+    name(f, i);
+    if ((fd = open(f, O_CREATE | O_TRUNC | O_WRONLY)) < 0) {
+      fprintf(2, "readbench: cannot create %s\n", f);
+      exit(1);
+    }
+    for (j = 0; j < FILESIZE; j += sizeof(buf)) {
+      if (write(fd, buf, sizeof(buf)) != sizeof(buf)) {
+        fprintf(2, "readbench: write %s failed\n", f);
+        exit(1);
+      }
+    }
+    close(fd);
+  }
+
+  old = setreadahead(-1);
+  for (i = 0; i < 2; i++) {
+    setreadahead(i == 0 ? 0 : (old > 0 ? old : RAMAX));
+    memstats(&st0);
+    us = pass(nfiles, &st);
+    printf("readbench: read-ahead %s: %d KiB in %lu us", i == 0 ? "off" : "on",
+           nfiles * FILESIZE / 1024, us);
+    if (us > 0)
+      printf(", %lu KB/s", (uint64)nfiles * FILESIZE / 1024 * 1000000 / us);
+    printf(", %lu disk requests, %lu blocks read ahead\n",
+           st.diskreqs - st0.diskreqs, st.bufahead - st0.bufahead);
+  }
+  setreadahead(old);
+
+  for (i = 0; i < nfiles; i++) {
+    name(f, i);
+    unlink(f);
+  }
+  exit(0);
+}
@@ -0,0 +1,263 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/pstat.h"
+#include "user/user.h"
+
+#define CPU   0
+#define IO    1
+#define INTER 2
+#define FORK  3
+
+static char *types[] = { "cpu", "io", "inter", "fork" };
+static char *policies[] = { "rr", "rrsp", "mlfq", "cfs" };
+
+// One result per job, sent to the parent over a pipe. Every job
+// writes exactly once, and MAXJOBS records fit in the pipe buffer,
+// so writes never block and records never interleave.
+struct result {
+  short type;
+  short id;
+  int pid;
+  uint response;    // us from fork to first run
+  uint turnaround;  // us from fork to exit
+  uint run;         // us running
+  uint wait;        // us waiting for a CPU
+  uint sleep;       // us sleeping
+  int pad;
+};
+
+#define MAXJOBS (512 / sizeof(struct result))
+
+// Workload sizes
+static long cpuwork = 100000000;   // loop iterations per cpu job
+static int iorounds = 20;          // pause(1) calls per io job
+static int pingpongs = 500;        // round trips per inter job
+static int forks = 50;             // children per fork job
+
+// Cycles to microseconds
+uint us(uint64 t) {
+  return t / (TIMEFREQ / 1000000);
+}
+
+void cpu_job() {
+  long i;
+  for (i = 0; i < cpuwork; i++) {
+    asm volatile("nop");
+  }
+}
+
+void io_job() {
+  for (int i = 0; i < iorounds; i++) {
+    pause(1);
+  }
+}
+
+// Interactive: bounce a byte with a partner process
+void inter_job() {
+  int ping[2], pong[2];
+  char c = 'x';
+  int i;
+
+  if (pipe(ping) < 0 || pipe(pong) < 0) {
+    printf("schedbench: pipe failed\n");
+    exit(1);
+  }
+  int pid = fork();
+  if (pid < 0) {
+    printf("schedbench: fork failed\n");
+    exit(1);
+  }
+  if (pid == 0) {
+    for (i = 0; i < pingpongs; i++) {
+      if (read(ping[0], &c, 1) != 1 || write(pong[1], &c, 1) != 1)
+        exit(1);
+    }
+    exit(0);
+  }
+  for (i = 0; i < pingpongs; i++) {
+    if (write(ping[1], &c, 1) != 1 || read(pong[0], &c, 1) != 1) {
+      printf("schedbench: ping-pong failed\n");
+      exit(1);
+    }
+  }
+  wait(0);
+  close(ping[0]); close(ping[1]);
+  close(pong[0]); close(pong[1]);
+}
+
+// Fork storm: short-lived children, one after another
+void fork_job() {
+  for (int i = 0; i < forks; i++) {
+    int pid = fork();
+    if (pid < 0) {
+      printf("schedbench: fork failed\n");
+      exit(1);
+    }
+    if (pid == 0)
+      exit(0);
+    wait(0);
+  }
+}
+
+// Body of a job process: run the workload and report to fd.
+void run_job(int type, int id, int fd) {
+  struct procstats st;
+  struct result r;
+
+  // Time spent waiting so far is the delay before our first run.
+  getprocstats(getpid(), &st);
+  r.response = us(st.waittime);
+
+  switch (type) {
+  case CPU:   cpu_job(); break;
+  case IO:    io_job(); break;
+  case INTER: inter_job(); break;
+  case FORK:  fork_job(); break;
+  }
+
+  getprocstats(getpid(), &st);
+  r.type = type;
+  r.id = id;
+  r.pid = getpid();
+  r.turnaround = us(st.runtime + st.waittime + st.sleeptime);
+  r.run = us(st.runtime);
+  r.wait = us(st.waittime);
+  r.sleep = us(st.sleeptime);
+  r.pad = 0;
+  write(fd, &r, sizeof(r));
+  exit(0);
+}
+
+// Lifetime of this process so far, in cycles
+uint64 lifetime() {
+  struct procstats st;
+  getprocstats(getpid(), &st);
+  return st.runtime + st.waittime + st.sleeptime;
+}
+
+void usage() {
+  fprintf(2, "usage: schedbench [policy=rr|rrsp|mlfq|cfs] [cpu=N] [io=N] [inter=N] [fork=N]\n");
+  fprintf(2, "                  [cpuwork=N] [iorounds=N] [pingpongs=N] [forks=N]\n");
+  exit(1);
+}
+
+/*
+ * schedbench.c
+ * Scheduler benchmark with a configurable mix of workloads:
+ *   cpu:   CPU-bound loop
+ *   io:    repeated pause(1), like ioboundtest
+ *   inter: interactive pipe ping-pong with a partner process
+ *   fork:  fork storm of short-lived children
+ * Times come from getprocstats(), so they are not limited to the
+ * clock tick. Prints one CSV line per job, then a summary line with
+ * throughput and Jain's fairness index over the cpu jobs' CPU rate
+ * (run time / turnaround time). Fixed-point values are x1000.
+ *
+ * usage: schedbench [policy=NAME] [cpu=N] [io=N] [inter=N] [fork=N] ...
+ */
+int
+main(int argc, char *argv[])
+{
+  int count[4] = { 4, 2, 1, 1 };
+  int policy = -1;
+  int fds[2];
+  int i, j, njobs, id, pid;
+  char *arg, *val;
+  struct result r;
+  uint64 start, elapsed, x, sum = 0, sumsq = 0;
+  int ncpu = 0;
+
+  for (i = 1; i < argc; i++) {
+    arg = argv[i];
+    val = strchr(arg, '=');
+    if (val == 0)
+      usage();
+    *val++ = 0;
+    if (strcmp(arg, "policy") == 0) {
+      for (policy = 0; policy < 4; policy++) {
+        if (strcmp(val, policies[policy]) == 0)
+          break;
+      }
+      if (policy == 4)
+        usage();
+    } else if (strcmp(arg, "cpuwork") == 0) {
+      cpuwork = atoi(val);
+    } else if (strcmp(arg, "iorounds") == 0) {
+      iorounds = atoi(val);
+    } else if (strcmp(arg, "pingpongs") == 0) {
+      pingpongs = atoi(val);
+    } else if (strcmp(arg, "forks") == 0) {
+      forks = atoi(val);
+    } else {
+      for (j = 0; j < 4; j++) {
+        if (strcmp(arg, types[j]) == 0)
+          break;
+      }
+      if (j == 4)
+        usage();
+      count[j] = atoi(val);
+    }
+  }
+
+  njobs = count[CPU] + count[IO] + count[INTER] + count[FORK];
+  if (njobs <= 0 || njobs > MAXJOBS) {
+    fprintf(2, "schedbench: between 1 and %d jobs\n", (int)MAXJOBS);
+    exit(1);
+  }
+  if (policy >= 0 && setscheduler(policy) < 0) {
+    fprintf(2, "schedbench: setscheduler failed\n");
+    exit(1);
+  }
+  policy = setscheduler(-1);
+
+  if (pipe(fds) < 0) {
+    fprintf(2, "schedbench: pipe failed\n");
+    exit(1);
+  }
+
+  start = lifetime();
+  id = 0;
+  for (j = 0; j < 4; j++) {
+    for (i = 0; i < count[j]; i++, id++) {
+      pid = fork();
+      if (pid < 0) {
+        fprintf(2, "schedbench: fork failed\n");
+        exit(1);
+      }
+      if (pid == 0) {
+        close(fds[0]);
+        run_job(j, id, fds[1]);
+      }
+    }
+  }
+  close(fds[1]);
+
+  printf("job,policy,type,id,pid,response_us,turnaround_us,run_us,wait_us,sleep_us\n");
+  for (i = 0; i < njobs; i++) {
+    if (read(fds[0], &r, sizeof(r)) != sizeof(r)) {
+      fprintf(2, "schedbench: lost a job result\n");
+      exit(1);
+    }
+    printf("job,%s,%s,%d,%d,%d,%d,%d,%d,%d\n", policies[policy], types[r.type],
+           r.id, r.pid, r.response, r.turnaround, r.run, r.wait, r.sleep);
+    if (r.type == CPU && r.turnaround > 0) {
+      x = (uint64)r.run * 1000 / r.turnaround;
+      sum += x;
+      sumsq += x * x;
+      ncpu++;
+    }
+  }
+  for (i = 0; i < njobs; i++) {
+    wait(0);
+  }
+  elapsed = lifetime() - start;
+
+  // Jain's index: (sum x)^2 / (n * sum x^2); 1000 is perfectly fair
+  uint64 jain = ncpu > 0 && sumsq > 0 ? sum * sum * 1000 / (ncpu * sumsq) : 1000;
+  uint64 tput = elapsed > 0 ? (uint64)njobs * TIMEFREQ * 1000 / elapsed : 0;
+  printf("summary,policy,jobs,elapsed_us,throughput_x1000_jobs_per_s,jain_x1000\n");
+  printf("summary,%s,%d,%d,%d,%d\n", policies[policy], njobs, us(elapsed),
+         (int)tput, (int)jain);
+  exit(0);
+}
@@ -0,0 +1,90 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NSLEEPERS 60
+#define ROUNDS    20000
+
+/*
+ * schedlat.c
+ * Measures context-switch latency while the process table is full.
+ * Creates NSLEEPERS children that block forever on a pipe read, then
+ * bounces a byte between two processes ROUNDS times. Each round trip
+ * is two trips through the scheduler, so the result shows how much
+ * a scheduling decision costs with many idle processes around.
+ *
+ * usage: schedlat [nsleepers] [rounds]
+ */
+int
+main(int argc, char *argv[])
+{
+  int nsleepers = NSLEEPERS;
+  int rounds = ROUNDS;
+  int hold[2], ping[2], pong[2];
+  int i, n, pid, start, elapsed;
+  char c;
+
+  if (argc > 1)
+    nsleepers = atoi(argv[1]);
+  if (argc > 2)
+    rounds = atoi(argv[2]);
+
+  if (pipe(hold) < 0 || pipe(ping) < 0 || pipe(pong) < 0) {
+    printf("schedlat: pipe failed\n");
+    exit(1);
+  }
+
+  // Sleepers: block on a read that only returns once we close hold[1].
+  for (n = 0; n < nsleepers; n++) {
+    pid = fork();
+    if (pid < 0)
+      break;
+    if (pid == 0) {
+      close(hold[1]);
+      read(hold[0], &c, 1);
+      exit(0);
+    }
+  }
+  close(hold[0]);
+  if (n < nsleepers)
+    printf("schedlat: only %d sleepers fit in the process table\n", n);
+
+  // The second runnable process echoes every byte back.
+  pid = fork();
+  if (pid < 0) {
+    printf("schedlat: fork failed\n");
+    exit(1);
+  }
+  if (pid == 0) {
+    close(hold[1]);
+    for (i = 0; i < rounds; i++) {
+      if (read(ping[0], &c, 1) != 1 || write(pong[1], &c, 1) != 1) {
+        printf("schedlat: echo failed\n");
+        exit(1);
+      }
+    }
+    exit(0);
+  }
+
+  start = uptime();
+  for (i = 0; i < rounds; i++) {
+    if (write(ping[1], "x", 1) != 1 || read(pong[0], &c, 1) != 1) {
+      printf("schedlat: ping failed\n");
+      exit(1);
+    }
+  }
+  elapsed = uptime() - start;
+  wait(0);
+
+  // Release the sleepers.
+  close(hold[1]);
+  for (i = 0; i < n; i++)
+    wait(0);
+
+  // A tick is about 100ms; report microseconds per context switch.
+  printf("schedlat: %d sleepers, %d round trips in %d ticks", n, rounds, elapsed);
+  if (elapsed > 0)
+    printf(", %d us per switch", (int)(elapsed * 100000L / (2L * rounds)));
+  printf("\n");
+  exit(0);
+}
@@ -0,0 +1,47 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+static char *names[] = {
+  [SCHED_RR]    "rr",
+  [SCHED_RRSP]  "rrsp",
+  [SCHED_MLFQ]  "mlfq",
+  [SCHED_CFS]   "cfs",
+};
+
+/*
+ * setsched.c
+ * Switches the scheduling policy of the running kernel, so that
+ * fairtest, nicetest and ioboundtest can be compared in one boot.
+ * With no argument, prints the current policy.
+ *
+ * usage: setsched [rr|rrsp|mlfq|cfs]
+ */
+int
+main(int argc, char *argv[])
+{
+  int policy, old;
+
+  if (argc < 2) {
+    printf("%s\n", names[setscheduler(-1)]);
+    exit(0);
+  }
+
+  for (policy = 0; policy <= SCHED_CFS; policy++) {
+    if (strcmp(argv[1], names[policy]) == 0)
+      break;
+  }
+  if (policy > SCHED_CFS) {
+    fprintf(2, "usage: setsched [rr|rrsp|mlfq|cfs]\n");
+    exit(1);
+  }
+
+  old = setscheduler(policy);
+  if (old < 0) {
+    fprintf(2, "setsched: failed\n");
+    exit(1);
+  }
+  printf("%s -> %s\n", names[old], names[policy]);
+  exit(0);
+}
@@ -0,0 +1,80 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/pstat.h"
+#include "user/user.h"
+
+static char *states[] = { "unused", "used", "sleep", "runble", "run", "zombie" };
+
+static struct procstats cur[NPROC], prev[NPROC];
+static int ncur, nprev;
+
+// Cycles to milliseconds
+int ms(uint64 t) {
+  return t / (TIMEFREQ / 1000);
+}
+
+// The previous sample of pid, or 0 if it was not running then
+struct procstats *lookup_prev(int pid) {
+  for (int i = 0; i < nprev; i++) {
+    if (prev[i].pid == pid)
+      return &prev[i];
+  }
+  return 0;
+}
+
+/*
+ * top.c
+ * Shows per-process CPU accounting from getprocstats(): time spent
+ * running, waiting for a CPU and sleeping, context switches and MLFQ
+ * demotions. %CPU is the share of the last interval spent running
+ * (of all time, for the first sample).
+ *
+ * usage: top [count [interval]]
+ *   count: number of samples (default 1)
+ *   interval: ticks between samples (default 10)
+ */
+int
+main(int argc, char *argv[])
+{
+  int count = 1, interval = 10;
+  int i, n, pct;
+  uint64 now, last = 0, run;
+  struct procstats *p, *q;
+
+  if (argc > 1)
+    count = atoi(argv[1]);
+  if (argc > 2)
+    interval = atoi(argv[2]);
+
+  for (n = 0; n < count; n++) {
+    if (n > 0)
+      pause(interval);
+    ncur = getprocstats(0, cur);
+    if (ncur < 0) {
+      printf("top: getprocstats failed\n");
+      exit(1);
+    }
+    now = (uint64)uptime() * TICKCYCLES;
+
+    printf("\nPID\tSTATE\tNICE\tQ\t%%CPU\tRUN ms\tWAIT ms\tSLEEP ms\tVCSW\tIVCSW\tDEMOTE\tNAME\n");
+    for (i = 0; i < ncur; i++) {
+      p = &cur[i];
+      q = lookup_prev(p->pid);
+      run = q ? p->runtime - q->runtime : p->runtime;
+      pct = 0;
+      if (now > last)
+        pct = run * 100 / (now - last);
+      printf("%d\t%s\t%d\t%d\t%d\t%d\t%d\t%d\t\t%d\t%d\t%d\t%s\n",
+             p->pid, p->state >= 0 && p->state < 6 ? states[p->state] : "???",
+             p->nice, p->queue_level, pct,
+             ms(p->runtime), ms(p->waittime), ms(p->sleeptime),
+             p->nvcsw, p->nivcsw, p->ndemote, p->name);
+    }
+
+    memmove(prev, cur, sizeof(cur));
+    nprev = ncur;
+    last = now;
+  }
+  exit(0);
+}
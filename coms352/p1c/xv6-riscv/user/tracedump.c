@@ -0,0 +1,80 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+#define BATCH 64
+
+// Sort events by time; each CPU's events are already in order,
+// so insertion sort does little work.
+void sort_events(struct traceevent *ev, int n) {
+  int i, j;
+  struct traceevent e;
+  for (i = 1; i < n; i++) {
+    e = ev[i];
+    for (j = i; j > 0 && ev[j-1].time > e.time; j--) {
+      ev[j] = ev[j-1];
+    }
+    ev[j] = e;
+  }
+}
+
+/*
+ * tracedump.c
+ * Reads the scheduler trace recorded while logging was on and prints
+ * it in time order, in the same format the kernel used to print to
+ * the console. With -v, also prints each event's CPU and r_time().
+ *
+ * usage: tracedump [-v]
+ */
+int
+main(int argc, char *argv[])
+{
+  struct traceevent *ev = 0, *bigger;
+  int n = 0, cap = 0, got, i;
+  int verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+  for (;;) {
+    if (n + BATCH > cap) {
+      cap = cap ? 2 * cap : 4 * BATCH;
+      bigger = malloc(cap * sizeof(*ev));
+      if (bigger == 0) {
+        printf("tracedump: out of memory\n");
+        exit(1);
+      }
+      if (ev) {
+        memmove(bigger, ev, n * sizeof(*ev));
+        free(ev);
+      }
+      ev = bigger;
+    }
+    got = readtrace(ev + n, BATCH);
+    if (got < 0) {
+      printf("tracedump: readtrace failed\n");
+      exit(1);
+    }
+    if (got == 0)
+      break;
+    n += got;
+  }
+
+  sort_events(ev, n);
+  for (i = 0; i < n; i++) {
+    if (verbose)
+      printf("cpu %d time %lu: ", ev[i].cpu, ev[i].time);
+    switch (ev[i].type) {
+    case TRACE_RUN:
+      printf("running %d at %d\n", ev[i].pid, ev[i].ticks);
+      break;
+    case TRACE_NICE:
+      printf("nice set to %d for %d\n", ev[i].arg, ev[i].pid);
+      break;
+    case TRACE_SCHED:
+      printf("scheduler set to %d\n", ev[i].arg);
+      break;
+    default:
+      printf("unknown event %d\n", ev[i].type);
+    }
+  }
+  exit(0);
+}
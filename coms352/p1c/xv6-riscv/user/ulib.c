@@ -159,3 +159,8 @@ sbrklazy(int n) {
   return sys_sbrk(n, SBRK_LAZY);
 }
 
+char *
+sbrkmega(int n) {
+  return sys_sbrk(n, SBRK_MEGA);
+}
+
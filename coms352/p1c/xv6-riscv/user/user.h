@@ -1,6 +1,12 @@
 #define SBRK_ERROR ((char *)-1)
+#define MAP_FAILED ((void *)-1)
 
 struct stat;
+struct traceevent;
+struct procstats;
+struct mlfqparams;
+struct memstats;
+struct lockstat;
 
 // system calls
 int fork(void);
@@ -28,6 +34,17 @@ int uptime(void);
 void startLogging(void);
 void stopLogging(void);
 int nice(int pid, int inc);
+int setscheduler(int policy);
+int readtrace(struct traceevent*, int n);
+int usleep(int usec);
+int getprocstats(int pid, struct procstats*);
+int mlfqtune(struct mlfqparams*, int set);
+int memstats(struct memstats*);
+void *mmap(void*, int, int, int, int, int);
+int munmap(void*, int);
+int lockstats(struct lockstat*, int n);
+int setreadahead(int max);
+int dropcache(void);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -43,6 +60,7 @@ int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
 char* sbrk(int);
 char* sbrklazy(int);
+char* sbrkmega(int);
 
 // printf.c
 void fprintf(int, const char*, ...) __attribute__ ((format (printf, 2, 3)));
@@ -7,6 +7,8 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/memstat.h"
+#include "kernel/lockstat.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -18,6 +20,7 @@
 //
 
 #define BUFSZ  ((MAXOPBLOCKS+2)*BSIZE)
+#define NINODE 50   // the kernel's old fixed inode table size
 
 char buf[BUFSZ];
 
@@ -1027,6 +1030,27 @@ forkforkfork(char *s)
   pause(10); // one second
 }
 
+// usleep() deadlines need not fall on clock ticks: ten 10ms
+// sleeps should take about one tick, not ten.
+void
+usleeptest(char *s)
+{
+  int i, start, elapsed;
+
+  start = uptime();
+  for(i = 0; i < 10; i++){
+    if(usleep(10000) < 0){
+      printf("%s: usleep failed\n", s);
+      exit(1);
+    }
+  }
+  elapsed = uptime() - start;
+  if(elapsed > 5){
+    printf("%s: ten 10ms sleeps took %d ticks\n", s, elapsed);
+    exit(1);
+  }
+}
+
 // regression test. does reparent() violate the parent-then-child
 // locking order when giving away a child to init, so that exit()
 // deadlocks against init's wait()? also used to trigger a "panic:
@@ -1089,6 +1113,455 @@ mem(char *s)
   }
 }
 
+// fork() shares memory copy-on-write: take two thirds of free
+// memory and fork twice, which an eager copy cannot do. each
+// child writes to a few pages, which must not show in the parent.
+void
+cowfork(char *s)
+{
+  struct memstats st;
+  int i, pid, xstatus, npages;
+  char *p;
+
+  memstats(&st);
+  npages = st.freepages / 3 * 2;
+  p = sbrk(npages * PGSIZE);
+  if(p == SBRK_ERROR){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < npages; i++)
+    p[i * PGSIZE] = i;
+
+  for(int k = 0; k < 2; k++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      for(i = 0; i < npages; i++){
+        if(p[i * PGSIZE] != (char)i){
+          printf("%s: child read wrong value\n", s);
+          exit(1);
+        }
+      }
+      for(i = 0; i < 10; i++)
+        p[i * PGSIZE] = -1;
+      exit(0);
+    }
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+
+  for(i = 0; i < npages; i++){
+    if(p[i * PGSIZE] != (char)i){
+      printf("%s: child write visible in parent\n", s);
+      exit(1);
+    }
+  }
+  sbrk(-npages * PGSIZE);
+}
+
+// sbrkmega() backs whole 2 MiB regions with megapages. write and
+// read them, fork (which splits the parent's megapages), then shrink
+// into the middle of one (which splits it too) and free the rest.
+void
+megasbrk(char *s)
+{
+  int n = 3 * MEGASIZE + 5 * PGSIZE;
+  int pid, xstatus;
+  char *p, *a;
+  struct memstats st0, st;
+
+  memstats(&st0);
+  p = sbrkmega(n);
+  if(p == SBRK_ERROR){
+    printf("%s: sbrkmega failed\n", s);
+    exit(1);
+  }
+  // n covers at least two whole aligned megapages, and each one
+  // takes a free 2 MiB block out of the allocator.
+  memstats(&st);
+  if(st.nfree[MEGAORDER] + 2 > st0.nfree[MEGAORDER]){
+    printf("%s: no megapages used (%lu free 2 MiB blocks before, %lu after)\n",
+           s, st0.nfree[MEGAORDER], st.nfree[MEGAORDER]);
+    exit(1);
+  }
+  for(a = p; a < p + n; a += PGSIZE)
+    *a = (uint64)a >> PGSHIFT;
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(a = p; a < p + n; a += PGSIZE){
+      if(*a != (char)((uint64)a >> PGSHIFT)){
+        printf("%s: child read wrong value\n", s);
+        exit(1);
+      }
+      *a = 0;
+    }
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(1);
+
+  sbrk(-(MEGASIZE + MEGASIZE / 2 + 5 * PGSIZE));
+  for(a = p; a < p + MEGASIZE + MEGASIZE / 2; a += PGSIZE){
+    if(*a != (char)((uint64)a >> PGSHIFT)){
+      printf("%s: parent read wrong value\n", s);
+      exit(1);
+    }
+  }
+  sbrk(-(MEGASIZE + MEGASIZE / 2));
+}
+
+// shrinking with sbrk() leaves an empty level-0 page table under
+// the freed range; a later sbrkmega() over the same 2 MiB must
+// replace it with a megapage rather than panic.
+void
+megaremap(char *s)
+{
+  char *p, *a, *top;
+  int n = 2 * MEGASIZE;
+  struct memstats st0, st;
+
+  // 4 KiB pages over the first whole megapage above the break
+  p = sbrk(0);
+  top = (char*)MEGAROUNDUP((uint64)p);
+  if(sbrk(top - p + MEGASIZE) == SBRK_ERROR){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(a = top; a < top + MEGASIZE; a += PGSIZE)
+    *a = 1;
+  sbrk(-MEGASIZE);
+
+  memstats(&st0);
+  if(sbrkmega(n) != top){
+    printf("%s: sbrkmega failed\n", s);
+    exit(1);
+  }
+  memstats(&st);
+  if(st.nfree[MEGAORDER] + 2 > st0.nfree[MEGAORDER]){
+    printf("%s: no megapages used (%lu free 2 MiB blocks before, %lu after)\n",
+           s, st0.nfree[MEGAORDER], st.nfree[MEGAORDER]);
+    exit(1);
+  }
+  for(a = top; a < top + n; a += PGSIZE){
+    if(*a != 0){
+      printf("%s: sbrkmega memory not zeroed\n", s);
+      exit(1);
+    }
+    *a = (uint64)a >> PGSHIFT;
+  }
+  for(a = top; a < top + n; a += PGSIZE){
+    if(*a != (char)((uint64)a >> PGSHIFT)){
+      printf("%s: read wrong value\n", s);
+      exit(1);
+    }
+  }
+  sbrk(-(top - p + n));
+}
+
+// exec() reads program pages in on first touch, and read-only
+// pages are shared through a cache: a second run of the same
+// program should find its text there instead of reading the file.
+static void
+runecho(char *s)
+{
+  char *args[] = { "echo", "textshare", 0 };
+  int pid, xstatus;
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    close(1);
+    if(open("textshare.out", O_CREATE|O_WRONLY) != 1)
+      exit(1);
+    exec("echo", args);
+    exit(1);
+  }
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: echo failed\n", s);
+    exit(1);
+  }
+}
+
+void
+textshare(char *s)
+{
+  struct memstats st0, st1, st2;
+
+  memstats(&st0);
+  runecho(s);
+  memstats(&st1);
+  runecho(s);
+  memstats(&st2);
+  unlink("textshare.out");
+
+  if(st1.filefaults == st0.filefaults){
+    printf("%s: exec read no pages on demand\n", s);
+    exit(1);
+  }
+  if(st2.texthits == st1.texthits){
+    printf("%s: second exec shared no text\n", s);
+    exit(1);
+  }
+}
+
+// mmap() a file private and read-only, then shared and writable,
+// and check that munmap() writes the shared changes back.
+void
+mmapfile(char *s)
+{
+  int n = 2 * PGSIZE + 100;
+  int i, fd, pid, xstatus;
+  char *p;
+
+  fd = open("mmapfile", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < n; i++){
+    char c = 'a' + i % 26;
+    if(write(fd, &c, 1) != 1){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+  }
+
+  p = mmap(0, 3 * PGSIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(p == MAP_FAILED){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 3 * PGSIZE; i++){
+    if(p[i] != (i < n ? 'a' + i % 26 : 0)){
+      printf("%s: wrong byte %d in private mapping\n", s, i);
+      exit(1);
+    }
+  }
+  if(munmap(p, 3 * PGSIZE) != 0){
+    printf("%s: munmap failed\n", s);
+    exit(1);
+  }
+
+  // the pages are gone.
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    printf("%s: %x\n", s, p[0]);
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != -1){
+    printf("%s: read unmapped memory\n", s);
+    exit(1);
+  }
+
+  p = mmap(0, n, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == MAP_FAILED){
+    printf("%s: shared mmap failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < n; i += 100)
+    p[i] = 'Z';
+  munmap(p, n);
+  close(fd);
+
+  fd = open("mmapfile", O_RDONLY);
+  for(i = 0; i < n; i++){
+    char c;
+    if(read(fd, &c, 1) != 1 || c != (i % 100 == 0 ? 'Z' : 'a' + i % 26)){
+      printf("%s: shared write %d not in file\n", s, i);
+      exit(1);
+    }
+  }
+  close(fd);
+  unlink("mmapfile");
+}
+
+// read() into, and write() from, pages of another file's mapping
+// that are not faulted in yet: the kernel must read them in without
+// holding the first file's lock.
+void
+mmapcross(char *s)
+{
+  int n = 2 * PGSIZE;
+  int i, fa, fb;
+  char *p, c;
+
+  fa = open("mmapcross.a", O_CREATE|O_RDWR);
+  fb = open("mmapcross.b", O_CREATE|O_RDWR);
+  if(fa < 0 || fb < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < n; i++){
+    char a = 'a' + i % 26, b = 'A' + i % 26;
+    if(write(fa, &a, 1) != 1 || write(fb, &b, 1) != 1){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+  }
+  close(fb);
+
+  // file b into a's mapping.
+  p = mmap(0, n, PROT_READ|PROT_WRITE, MAP_PRIVATE, fa, 0);
+  if(p == MAP_FAILED){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+  fb = open("mmapcross.b", O_RDONLY);
+  if(read(fb, p, n) != n){
+    printf("%s: read into mapping failed\n", s);
+    exit(1);
+  }
+  close(fb);
+  for(i = 0; i < n; i++){
+    if(p[i] != 'A' + i % 26){
+      printf("%s: wrong byte %d read into mapping\n", s, i);
+      exit(1);
+    }
+  }
+  munmap(p, n);
+
+  // a fresh mapping of a into file b.
+  p = mmap(0, n, PROT_READ, MAP_PRIVATE, fa, 0);
+  if(p == MAP_FAILED){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+  fb = open("mmapcross.b", O_WRONLY);
+  if(write(fb, p, n) != n){
+    printf("%s: write from mapping failed\n", s);
+    exit(1);
+  }
+  close(fb);
+  munmap(p, n);
+  close(fa);
+
+  fb = open("mmapcross.b", O_RDONLY);
+  for(i = 0; i < n; i++){
+    if(read(fb, &c, 1) != 1 || c != 'a' + i % 26){
+      printf("%s: wrong byte %d written from mapping\n", s, i);
+      exit(1);
+    }
+  }
+  close(fb);
+  unlink("mmapcross.a");
+  unlink("mmapcross.b");
+}
+
+// anonymous mappings: private ones are copied by fork(), shared
+// ones are not, and munmap() can split a mapping in two.
+void
+mmapanon(char *s)
+{
+  char *priv, *shared;
+  int i, pid, xstatus;
+
+  priv = mmap(0, 4 * PGSIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+  shared = mmap(0, PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+  if(priv == MAP_FAILED || shared == MAP_FAILED){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 4 * PGSIZE; i += PGSIZE){
+    if(priv[i] != 0){
+      printf("%s: anonymous memory not zeroed\n", s);
+      exit(1);
+    }
+    priv[i] = i / PGSIZE + 1;
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(priv[PGSIZE] != 2)
+      exit(1);
+    priv[PGSIZE] = 9;
+    shared[0] = 9;
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0 || priv[PGSIZE] != 2 || shared[0] != 9){
+    printf("%s: fork shared the wrong memory\n", s);
+    exit(1);
+  }
+
+  if(munmap(priv + PGSIZE, 2 * PGSIZE) != 0){
+    printf("%s: munmap of the middle failed\n", s);
+    exit(1);
+  }
+  if(priv[0] != 1 || priv[3 * PGSIZE] != 4){
+    printf("%s: munmap lost the ends\n", s);
+    exit(1);
+  }
+  munmap(priv, 4 * PGSIZE);
+  munmap(shared, PGSIZE);
+}
+
+// files and pipes come from slab caches, so there is no system-wide
+// limit on open files: hold more open at once than the old table
+// of 100 had room for.
+void
+manyfiles(char *s)
+{
+  enum { NCHILD = 10, NPIPE = 6 };  // 120 pipe files
+  int i, j, pid, xstatus;
+  int hold[2], fds[2];
+  char c;
+
+  if(pipe(hold) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < NCHILD; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      close(hold[1]);
+      for(j = 0; j < NPIPE; j++){
+        if(pipe(fds) < 0){
+          printf("%s: pipe %d failed\n", s, j);
+          exit(1);
+        }
+      }
+      // keep them open until the parent closes hold[1]
+      read(hold[0], &c, 1);
+      exit(0);
+    }
+  }
+  pause(5);
+  close(hold[1]);
+  for(i = 0; i < NCHILD; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+}
+
 // More file system tests
 
 // two processes write to the same file descriptor
@@ -1148,6 +1621,147 @@ sharedfd(char *s)
   }
 }
 
+// read a file sequentially from a cold cache, in small and large
+// reads, so that readi() reads ahead; the data must be right.
+void
+readahead(char *s)
+{
+  enum { NBLOCK=100 };
+  struct memstats st0, st;
+  char data[BSIZE];
+  int fd, b, i, n;
+
+  fd = open("ra", O_CREATE | O_RDWR);
+  if(fd < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  for(b = 0; b < NBLOCK; b++){
+    memset(data, b, BSIZE);
+    if(write(fd, data, BSIZE) != BSIZE){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+
+  memstats(&st0);
+  for(n = 100; n <= BSIZE; n += BSIZE - 100){
+    dropcache();
+    fd = open("ra", O_RDONLY);
+    for(i = 0; i < NBLOCK * BSIZE; i += n){
+      if(read(fd, data, n) != n && i + n <= NBLOCK * BSIZE){
+        printf("%s: short read\n", s);
+        exit(1);
+      }
+      if(data[0] != (char)(i / BSIZE)){
+        printf("%s: wrong data at %d\n", s, i);
+        exit(1);
+      }
+    }
+    close(fd);
+  }
+  memstats(&st);
+  unlink("ra");
+  if(st.bufahead == st0.bufahead){
+    printf("%s: nothing was read ahead\n", s);
+    exit(1);
+  }
+}
+
+// a file read a second time should come from the buffer cache,
+// which now holds more than the NBUF blocks it starts with.
+void
+bcachehit(char *s)
+{
+  struct memstats st;
+  uint64 misses;
+  int fd, n, pass;
+
+  for(pass = 0; pass < 2; pass++){
+    memstats(&st);
+    misses = st.bufmisses;
+    fd = open("README", O_RDONLY);
+    if(fd < 0){
+      printf("%s: open README failed\n", s);
+      exit(1);
+    }
+    while((n = read(fd, buf, sizeof(buf))) > 0)
+      ;
+    close(fd);
+  }
+  memstats(&st);
+  if(st.bufmisses != misses){
+    printf("%s: second read missed %d times\n", s, (int)(st.bufmisses - misses));
+    exit(1);
+  }
+}
+
+// processes read and write files of more blocks than the buffer
+// cache holds at the same time, so that buffers are recycled from
+// one hash bucket to another; then check that the bucket locks
+// were used.
+void
+bcachepar(char *s)
+{
+  enum { NCHILD=4, NBLOCK=40 };
+  static struct lockstat ls[NLOCKSTAT];
+  char name[3], data[BSIZE];
+  int fd, pid, i, b, n, xstatus;
+
+  for(i = 0; i < NCHILD; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      name[0] = 'b';
+      name[1] = '0' + i;
+      name[2] = 0;
+      fd = open(name, O_CREATE | O_RDWR);
+      if(fd < 0){
+        printf("%s: create failed\n", s);
+        exit(1);
+      }
+      for(b = 0; b < NBLOCK; b++){
+        memset(data, i * NBLOCK + b, BSIZE);
+        if(write(fd, data, BSIZE) != BSIZE){
+          printf("%s: write failed\n", s);
+          exit(1);
+        }
+      }
+      close(fd);
+      fd = open(name, O_RDONLY);
+      for(b = 0; b < NBLOCK; b++){
+        if(read(fd, data, BSIZE) != BSIZE ||
+           data[0] != (char)(i * NBLOCK + b) ||
+           data[BSIZE - 1] != (char)(i * NBLOCK + b)){
+          printf("%s: read back wrong data\n", s);
+          exit(1);
+        }
+      }
+      close(fd);
+      unlink(name);
+      exit(0);
+    }
+  }
+  for(i = 0; i < NCHILD; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(xstatus);
+  }
+
+  n = lockstats(ls, NLOCKSTAT);
+  for(i = 0; i < n; i++)
+    if(strcmp(ls[i].name, "bcache.bucket") == 0)
+      break;
+  if(i == n || ls[i].nlocks < 2 || ls[i].nacquire == 0){
+    printf("%s: no bcache bucket locks in lockstats\n", s);
+    exit(1);
+  }
+}
+
 // four processes write different files at the same
 // time, to test block allocation.
 void
@@ -2723,6 +3337,7 @@ struct test {
   {pipe1, "pipe1"},
   {killstatus, "killstatus"},
   {preempt, "preempt"},
+  {usleeptest, "usleep"},
   {exitwait, "exitwait"},
   {reparent, "reparent" },
   {twochildren, "twochildren"},
@@ -2730,8 +3345,19 @@ struct test {
   {forkforkfork, "forkforkfork"},
   {reparent2, "reparent2"},
   {mem, "mem"},
+  {cowfork, "cowfork"},
+  {manyfiles, "manyfiles"},
+  {megasbrk, "megasbrk"},
+  {megaremap, "megaremap"},
+  {textshare, "textshare"},
+  {mmapfile, "mmapfile"},
+  {mmapcross, "mmapcross"},
+  {mmapanon, "mmapanon"},
   {sharedfd, "sharedfd"},
   {fourfiles, "fourfiles"},
+  {bcachepar, "bcachepar"},
+  {bcachehit, "bcachehit"},
+  {readahead, "readahead"},
   {createdelete, "createdelete"},
   {unlinkread, "unlinkread"},
   {linktest, "linktest"},
@@ -2941,6 +3567,141 @@ execout(char *s)
   exit(0);
 }
 
+// use more memory than the machine has, so that the kernel must
+// page some of it out to swap and read it back, including pages
+// that a child of fork() shares.
+void
+swap(char *s)
+{
+  struct memstats st;
+  int n, i, pid, xstatus;
+  uint64 outs;
+  char *p;
+
+  if(memstats(&st) < 0){
+    printf("%s: memstats failed\n", s);
+    exit(1);
+  }
+  if(st.swapsize - st.swapused < 2048){
+    printf("%s: not enough swap space\n", s);
+    exit(1);
+  }
+  outs = st.swapouts;
+  n = st.freepages + 1024;
+  p = sbrklazy(n * PGSIZE);
+  if(p == SBRK_ERROR){
+    printf("%s: sbrklazy failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < n; i++)
+    *(int*)(p + i * PGSIZE) = i;
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(i = 0; i < n; i += 97){
+      if(*(int*)(p + i * PGSIZE) != i){
+        printf("%s: child read page %d wrong\n", s, i);
+        exit(1);
+      }
+    }
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(1);
+
+  for(i = 0; i < n; i++){
+    if(*(int*)(p + i * PGSIZE) != i){
+      printf("%s: page %d read back wrong\n", s, i);
+      exit(1);
+    }
+  }
+  memstats(&st);
+  if(st.swapouts == outs){
+    printf("%s: nothing was paged out\n", s);
+    exit(1);
+  }
+  sbrk(-n * PGSIZE);
+}
+
+// shrink the heap and unmap memory while another process keeps
+// memory short, so that the kernel pages out pages that are being
+// unmapped; every swap slot must be freed again afterwards.
+void
+swapunmap(char *s)
+{
+  enum { N=64, ROUNDS=100 };
+  struct memstats st;
+  uint64 used;
+  int n, i, r, pid, xstatus;
+  char *p, *m;
+
+  if(memstats(&st) < 0){
+    printf("%s: memstats failed\n", s);
+    exit(1);
+  }
+  if(st.swapsize - st.swapused < 1024 + 2 * N){
+    printf("%s: not enough swap space\n", s);
+    exit(1);
+  }
+  used = st.swapused;
+  n = st.freepages + 512;
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    // the hog: touch more pages than there are, over and over.
+    p = sbrklazy(n * PGSIZE);
+    if(p == SBRK_ERROR)
+      exit(1);
+    for(r = 0; r < 3; r++)
+      for(i = 0; i < n; i++)
+        p[i * PGSIZE] = r;
+    exit(0);
+  }
+
+  for(r = 0; r < ROUNDS; r++){
+    p = sbrklazy(N * PGSIZE);
+    m = mmap(0, N * PGSIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+    if(p == SBRK_ERROR || m == MAP_FAILED){
+      printf("%s: sbrklazy or mmap failed\n", s);
+      exit(1);
+    }
+    for(i = 0; i < N; i++){
+      p[i * PGSIZE] = i;
+      m[i * PGSIZE] = i;
+    }
+    for(i = 0; i < N; i++){
+      if(p[i * PGSIZE] != i || m[i * PGSIZE] != i){
+        printf("%s: page %d read back wrong\n", s, i);
+        exit(1);
+      }
+    }
+    if(sbrk(-N * PGSIZE) == SBRK_ERROR || munmap(m, N * PGSIZE) != 0){
+      printf("%s: sbrk(-n) or munmap failed\n", s);
+      exit(1);
+    }
+  }
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: hog failed\n", s);
+    exit(1);
+  }
+
+  memstats(&st);
+  if(st.swapused != used){
+    printf("%s: %d swap slots leaked\n", s, (int)(st.swapused - used));
+    exit(1);
+  }
+}
+
 // can the kernel tolerate running out of disk space?
 void
 diskfull(char *s)
@@ -3060,6 +3821,8 @@ struct test slowtests[] = {
   {execout, "execout"},
   {diskfull, "diskfull"},
   {outofinodes, "outofinodes"},
+  {swap, "swap"},
+  {swapunmap, "swapunmap"},
     
   { 0, 0},
 };
@@ -45,4 +45,15 @@ entry("uptime");
 # Added system calls to pearl script to allow user space to access them
 entry("startLogging");
 entry("stopLogging");
-entry("nice");
\ No newline at end of file
+entry("nice");
+entry("setscheduler");
+entry("readtrace");
+entry("usleep");
+entry("getprocstats");
+entry("mlfqtune");
+entry("memstats");
+entry("mmap");
+entry("munmap");
+entry("lockstats");
+entry("setreadahead");
+entry("dropcache");
\ No newline at end of file
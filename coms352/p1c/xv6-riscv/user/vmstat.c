@@ -0,0 +1,50 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+#define TICKS_PER_SEC (TIMEFREQ / TICKCYCLES)
+
+/*
+ * vmstat.c
+ * Prints a line of paging statistics from memstats() every
+ * interval seconds: free pages, swap pages in use, and the pages
+ * read back from swap, written to swap and dropped (clean file
+ * pages) during the interval. The first line counts since boot.
+ *
+ * usage: vmstat [interval] [count]
+ */
+int
+main(int argc, char *argv[])
+{
+  struct memstats st, last;
+  int interval = 1, count = -1;
+
+  if (argc > 1)
+    interval = atoi(argv[1]);
+  if (argc > 2)
+    count = atoi(argv[2]);
+  if (interval <= 0) {
+    fprintf(2, "usage: vmstat [interval] [count]\n");
+    exit(1);
+  }
+
+  memset(&last, 0, sizeof(last));
+  printf("free  swapused  in  out  drop\n");
+  while (count != 0) {
+    if (memstats(&st) < 0) {
+      fprintf(2, "vmstat: memstats failed\n");
+      exit(1);
+    }
+    printf("%lu  %lu  %lu  %lu  %lu\n", st.freepages, st.swapused,
+           st.swapins - last.swapins, st.swapouts - last.swapouts,
+           st.swapdrops - last.swapdrops);
+    last = st;
+    if (count > 0)
+      count--;
+    if (count != 0)
+      pause(interval * TICKS_PER_SEC);
+  }
+  exit(0);
+}